@@ -0,0 +1,177 @@
+#ifndef ANALYSIS_C
+#define ANALYSIS_C
+
+#include "clock.c"
+#include "game_state.c"
+#include "policy.c"
+#include "replay.c"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+typedef struct {
+    SearchResult search;
+    bool done;
+} AnalysisMove;
+
+// positions are handed out in chunks that start on a replay keyframe, so each
+// worker seeks once and then only steps forward. results land in moves[] out
+// of order and are printed in order as soon as the next one is done
+typedef struct {
+    const Replay *replay;
+    const Policy *policy;
+    AnalysisMove *moves; // indexed by replay step
+    size_t next_chunk;
+    size_t chunks;
+    pthread_mutex_t lock;
+    pthread_cond_t progress;
+    MonteCarloStats stats;
+} Analysis;
+
+static void *Analysis_worker(void *arg) {
+    Analysis *analysis = arg;
+    const Replay *replay = analysis->replay;
+    size_t length = Replay_length(replay);
+
+    GameState *gs = GameState_create(replay->dim, 0);
+
+    while (gs) {
+        pthread_mutex_lock(&analysis->lock);
+        size_t chunk = analysis->next_chunk++;
+        pthread_mutex_unlock(&analysis->lock);
+        if (chunk >= analysis->chunks) {
+            break;
+        }
+
+        size_t begin = chunk * replay->interval;
+        size_t end = begin + replay->interval;
+        if (end > length - 1) {
+            end = length - 1;
+        }
+
+        // gs holds the position before step i, i.e. the one that was played
+        gs = Replay_seek(replay, gs, begin);
+        for (size_t i = begin + 1; i <= end; ++i) {
+            SearchResult search = {.can_move = false};
+            MonteCarloStats stats = {0};
+            if (!replay->steps[i].is_board) {
+                // seeded by position so reruns sample the same playouts
+                unsigned int seed = (unsigned int)i;
+                search = Policy_evaluate(analysis->policy, gs, &seed, &stats);
+            }
+
+            pthread_mutex_lock(&analysis->lock);
+            analysis->moves[i] = (AnalysisMove){.search = search, .done = true};
+            analysis->stats.playouts += stats.playouts;
+            pthread_cond_broadcast(&analysis->progress);
+            pthread_mutex_unlock(&analysis->lock);
+
+            gs = Replay_step(replay, gs, i);
+        }
+    }
+
+    GameState_destroy_chain(gs);
+    return NULL;
+}
+
+// grade every move of a replay against the move policy prefers, writing one
+// tab separated line per move to out
+bool Analysis_run(const Replay *replay, const Policy *policy, FILE *out) {
+    size_t length = Replay_length(replay);
+    long start = Clock_now_ns();
+    Analysis analysis = {
+        .replay = replay,
+        .policy = policy,
+        .moves = calloc(length, sizeof(AnalysisMove)),
+        .next_chunk = 0,
+        .chunks = (length - 1 + replay->interval - 1) / replay->interval,
+        .stats = {0},
+    };
+    if (!analysis.moves) {
+        return false;
+    }
+    pthread_mutex_init(&analysis.lock, NULL);
+    pthread_cond_init(&analysis.progress, NULL);
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t nr_of_workers = cpus > 0 ? (size_t)cpus : 1;
+    pthread_t *workers = calloc(nr_of_workers, sizeof(pthread_t));
+    size_t started = 0;
+    while (workers && started < nr_of_workers &&
+           pthread_create(&workers[started], NULL, Analysis_worker,
+                          &analysis) == 0) {
+        started++;
+    }
+
+    bool ok = started > 0;
+    size_t graded = 0;
+    size_t best_played = 0;
+    double total_loss = 0.0;
+    if (ok) {
+        fprintf(out, "move\tplayed\tbest\tplayed_ev\tbest_ev\tloss\n");
+    }
+
+    for (size_t i = 1; ok && i < length; ++i) {
+        pthread_mutex_lock(&analysis.lock);
+        if (!analysis.moves[i].done) {
+            // about to block, so let everything graded so far out first
+            fflush(out);
+            while (!analysis.moves[i].done) {
+                pthread_cond_wait(&analysis.progress, &analysis.lock);
+            }
+        }
+        SearchResult search = analysis.moves[i].search;
+        pthread_mutex_unlock(&analysis.lock);
+
+        if (replay->steps[i].is_board || !search.can_move) {
+            continue;
+        }
+
+        // a played move that ties for best is reported as the best one
+        Direction played = replay->steps[i].dir;
+        Direction best = search.best;
+        if (search.value[played] >= search.value[best]) {
+            best = played;
+        }
+        double loss = search.value[best] - search.value[played];
+        fprintf(out, "%zu\t%s\t%s\t%.1f\t%.1f\t%.1f\n", i,
+                direction_names[played], direction_names[best],
+                search.value[played], search.value[best], loss);
+
+        graded++;
+        total_loss += loss;
+        if (loss <= 0.0) {
+            best_played++;
+        }
+    }
+
+    for (size_t i = 0; i < started; ++i) {
+        pthread_join(workers[i], NULL);
+    }
+
+    if (ok) {
+        fprintf(out, "# %zu moves, %zu best, total loss %.1f, mean loss %.2f\n",
+                graded, best_played, total_loss,
+                graded > 0 ? total_loss / (double)graded : 0.0);
+        if (policy->kind == POLICY_MONTECARLO) {
+            long elapsed_ns = Clock_now_ns() - start;
+            fprintf(out, "# %zu playouts, %.0f playouts/s\n",
+                    analysis.stats.playouts,
+                    elapsed_ns > 0 ? (double)analysis.stats.playouts *
+                                         NS_PER_SECOND / (double)elapsed_ns
+                                   : 0.0);
+        }
+    }
+
+    free(workers);
+    pthread_cond_destroy(&analysis.progress);
+    pthread_mutex_destroy(&analysis.lock);
+    free(analysis.moves);
+    return ok;
+}
+
+#endif // ANALYSIS_C
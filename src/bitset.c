@@ -0,0 +1,117 @@
+#ifndef BITSET_C
+#define BITSET_C
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define BITSET_WORD_BITS 64
+#define BITSET_NONE SIZE_MAX
+
+// fixed size bitsets stored as plain uint64_t arrays, bit b lives in word
+// b / 64. the atomic variants may race with each other on the same word
+
+static inline size_t Bitset_words(size_t bits) {
+    return (bits + BITSET_WORD_BITS - 1) / BITSET_WORD_BITS;
+}
+
+static inline uint64_t Bitset_mask(size_t bit) {
+    return (uint64_t)1 << (bit % BITSET_WORD_BITS);
+}
+
+static inline bool Bitset_test(const uint64_t *bits, size_t bit) {
+    return (bits[bit / BITSET_WORD_BITS] & Bitset_mask(bit)) != 0;
+}
+
+static inline void Bitset_set(uint64_t *bits, size_t bit) {
+    bits[bit / BITSET_WORD_BITS] |= Bitset_mask(bit);
+}
+
+static inline void Bitset_clear(uint64_t *bits, size_t bit) {
+    bits[bit / BITSET_WORD_BITS] &= ~Bitset_mask(bit);
+}
+
+static inline void Bitset_set_atomic(uint64_t *bits, size_t bit) {
+    __atomic_fetch_or(&bits[bit / BITSET_WORD_BITS], Bitset_mask(bit),
+                      __ATOMIC_RELAXED);
+}
+
+static inline void Bitset_clear_atomic(uint64_t *bits, size_t bit) {
+    __atomic_fetch_and(&bits[bit / BITSET_WORD_BITS], ~Bitset_mask(bit),
+                       __ATOMIC_RELAXED);
+}
+
+static inline size_t Bitset_count(const uint64_t *bits, size_t words) {
+    size_t count = 0;
+    for (size_t w = 0; w < words; ++w) {
+        count += __builtin_popcountll(bits[w]);
+    }
+    return count;
+}
+
+static inline bool Bitset_empty(const uint64_t *bits, size_t words) {
+    for (size_t w = 0; w < words; ++w) {
+        if (bits[w] != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// lowest set bit at or above from, or BITSET_NONE
+static inline size_t Bitset_next(const uint64_t *bits, size_t words,
+                                 size_t from) {
+    size_t w = from / BITSET_WORD_BITS;
+    if (w >= words) {
+        return BITSET_NONE;
+    }
+    uint64_t word = bits[w] & (~(uint64_t)0 << (from % BITSET_WORD_BITS));
+    while (word == 0) {
+        if (++w == words) {
+            return BITSET_NONE;
+        }
+        word = bits[w];
+    }
+    return (w * BITSET_WORD_BITS) + __builtin_ctzll(word);
+}
+
+// highest set bit at or below from, or BITSET_NONE
+static inline size_t Bitset_prev(const uint64_t *bits, size_t from) {
+    size_t w = from / BITSET_WORD_BITS;
+    size_t shift = BITSET_WORD_BITS - 1 - (from % BITSET_WORD_BITS);
+    uint64_t word = bits[w] & (~(uint64_t)0 >> shift);
+    while (word == 0) {
+        if (w-- == 0) {
+            return BITSET_NONE;
+        }
+        word = bits[w];
+    }
+    return (w * BITSET_WORD_BITS) + (BITSET_WORD_BITS - 1) -
+           __builtin_clzll(word);
+}
+
+// index of the n-th (from 0) clear bit below limit, or BITSET_NONE
+static inline size_t Bitset_nth_clear(const uint64_t *bits, size_t limit,
+                                      size_t n) {
+    size_t words = Bitset_words(limit);
+    for (size_t w = 0; w < words; ++w) {
+        uint64_t clear = ~bits[w];
+        size_t left = limit - (w * BITSET_WORD_BITS);
+        if (left < BITSET_WORD_BITS) {
+            clear &= Bitset_mask(left) - 1;
+        }
+
+        size_t count = __builtin_popcountll(clear);
+        if (n >= count) {
+            n -= count;
+            continue;
+        }
+        while (n-- > 0) {
+            clear &= clear - 1;
+        }
+        return (w * BITSET_WORD_BITS) + __builtin_ctzll(clear);
+    }
+    return BITSET_NONE;
+}
+
+#endif // BITSET_C
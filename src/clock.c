@@ -0,0 +1,16 @@
+#ifndef CLOCK_C
+#define CLOCK_C
+
+#include <time.h>
+
+#define NS_PER_MS 1000000L
+#define NS_PER_SECOND 1000000000L
+
+// monotonic time in nanoseconds, only meaningful as a difference
+static long Clock_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec * NS_PER_SECOND) + now.tv_nsec;
+}
+
+#endif // CLOCK_C
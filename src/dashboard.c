@@ -0,0 +1,340 @@
+#ifndef DASHBOARD_C
+#define DASHBOARD_C
+
+#include "clock.c"
+#include "game_state.c"
+#include "policy.c"
+#include "render.c"
+#include <ncurses.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define DASHBOARD_DEFAULT_FPS 30
+#define DASHBOARD_STATUS_HEIGHT 1
+
+// one autoplayed game. the worker owns gs and seed; everything below lock is
+// the snapshot it publishes for the render thread
+typedef struct {
+    GameState *gs;
+    unsigned int seed;
+    pthread_mutex_t lock;
+    uint32_t *tiles;
+    uint32_t score;
+    size_t moves;
+    size_t games;
+    uint32_t best;
+    bool dirty;
+} DashboardBoard;
+
+typedef struct {
+    DashboardBoard *boards;
+    size_t nr_of_boards;
+    size_t nr_of_workers;
+    size_t dim;
+    const Policy *policy;
+    pthread_mutex_t lock;
+    bool stop;
+    MonteCarloStats stats;
+} Dashboard;
+
+typedef struct {
+    Dashboard *dashboard;
+    size_t worker;
+} DashboardWorker;
+
+static bool Dashboard_stopped(Dashboard *dashboard) {
+    pthread_mutex_lock(&dashboard->lock);
+    bool stop = dashboard->stop;
+    pthread_mutex_unlock(&dashboard->lock);
+    return stop;
+}
+
+static void DashboardBoard_publish(DashboardBoard *board) {
+    pthread_mutex_lock(&board->lock);
+    memcpy(board->tiles, board->gs->tiles.items,
+           board->gs->tiles.length * sizeof(uint32_t));
+    board->score = board->gs->score;
+    board->dirty = true;
+    pthread_mutex_unlock(&board->lock);
+}
+
+// play one move on board, starting a new game when the current one is over.
+// returns false only if a new game could not be allocated
+static bool DashboardBoard_advance(Dashboard *dashboard,
+                                   DashboardBoard *board) {
+    MonteCarloStats stats = {0};
+    SearchResult search =
+        Policy_evaluate(dashboard->policy, board->gs, &board->seed, &stats);
+    pthread_mutex_lock(&dashboard->lock);
+    dashboard->stats.playouts += stats.playouts;
+    dashboard->stats.elapsed_ns += stats.elapsed_ns;
+    pthread_mutex_unlock(&dashboard->lock);
+
+    GameState *next = NULL;
+    if (search.can_move) {
+        next = GameState_slide_and_merge(board->gs, search.best);
+    }
+
+    if (next) {
+        board->gs = next;
+        GameState_add_random_r(next, &board->seed);
+        pthread_mutex_lock(&board->lock);
+        board->moves++;
+        pthread_mutex_unlock(&board->lock);
+    }
+
+    if (!next || !GameState_can_move(board->gs)) {
+        GameState *fresh =
+            GameState_create_r(board->gs->dim, 0, &board->seed);
+        if (!fresh) {
+            return false;
+        }
+        pthread_mutex_lock(&board->lock);
+        if (board->gs->score > board->best) {
+            board->best = board->gs->score;
+        }
+        board->games++;
+        board->moves = 0;
+        pthread_mutex_unlock(&board->lock);
+        GameState_destroy_chain(board->gs);
+        board->gs = fresh;
+    }
+
+    DashboardBoard_publish(board);
+    return true;
+}
+
+// each worker plays boards worker, worker + nr_of_workers, ... in turn, so
+// every board only ever has one writer and no worker waits on the screen
+static void *Dashboard_worker(void *arg) {
+    DashboardWorker *worker = arg;
+    Dashboard *dashboard = worker->dashboard;
+
+    bool ok = true;
+    while (ok && !Dashboard_stopped(dashboard)) {
+        for (size_t b = worker->worker; ok && b < dashboard->nr_of_boards;
+             b += dashboard->nr_of_workers) {
+            ok = DashboardBoard_advance(dashboard, &dashboard->boards[b]);
+        }
+    }
+    return NULL;
+}
+
+static void Dashboard_draw_board(WINDOW *win, DashboardBoard *board,
+                                 GameState *view, Viewport *viewport) {
+    pthread_mutex_lock(&board->lock);
+    memcpy(view->tiles.items, board->tiles,
+           view->tiles.length * sizeof(uint32_t));
+    view->score = board->score;
+    size_t moves = board->moves;
+    size_t games = board->games;
+    uint32_t best = board->best;
+    board->dirty = false;
+    pthread_mutex_unlock(&board->lock);
+    GameState_sync_occupancy(view);
+
+    int height = 0;
+    int width = 0;
+    getmaxyx(win, height, width);
+
+    werase(win);
+    int drawn =
+        GameState_print_window(win, 0, 0, height - DASHBOARD_STATUS_HEIGHT,
+                               width, view, viewport);
+    mvwprintw(win, drawn, 0, "Game %zu  Moves %zu  Best %u", games + 1,
+              moves, best);
+    wnoutrefresh(win);
+}
+
+// render loop, runs on the calling thread. only boards that changed since
+// the last frame are repainted, and never more than fps times a second
+static void Dashboard_render(Dashboard *dashboard, size_t fps) {
+    size_t nr_of_boards = dashboard->nr_of_boards;
+
+    // boards too big for the screen are shown with compact cells, and if
+    // even that does not fit only their top left corner is shown
+    Viewport viewport = {.row = 0, .col = 0, .compact = false};
+    if (GameState_print_height(dashboard->dim, false) +
+                DASHBOARD_STATUS_HEIGHT >
+            LINES - 1 ||
+        GameState_print_width(dashboard->dim, false) > COLS) {
+        viewport.compact = true;
+    }
+    int board_h = GameState_print_height(dashboard->dim, viewport.compact) +
+                  DASHBOARD_STATUS_HEIGHT;
+    int board_w = GameState_print_width(dashboard->dim, viewport.compact);
+    if (board_h > LINES - 1) {
+        board_h = LINES - 1;
+    }
+    if (board_w > COLS) {
+        board_w = COLS;
+    }
+    int per_row = COLS / (board_w + 1);
+    if (per_row < 1) {
+        per_row = 1;
+    }
+
+    // boards that do not fit on the screen keep playing but are not shown
+    WINDOW **windows = calloc(nr_of_boards, sizeof(WINDOW *));
+    GameState **views = calloc(nr_of_boards, sizeof(GameState *));
+    if (!windows || !views) {
+        free(windows);
+        free(views);
+        return;
+    }
+    for (size_t b = 0; b < nr_of_boards; ++b) {
+        int y = (int)(b / per_row) * (board_h + 1);
+        int x = (int)(b % per_row) * (board_w + 1);
+        if (y + board_h <= LINES - 1 && x + board_w <= COLS) {
+            windows[b] = newwin(board_h, board_w, y, x);
+            views[b] = GameState_create(dashboard->dim, 0);
+        }
+    }
+
+    erase();
+    mvprintw(LINES - 1, 0, "Autoplaying %zu boards at %zu fps. Quit with q.",
+             nr_of_boards, fps);
+    wnoutrefresh(stdscr);
+
+    long frame_ns = NS_PER_SECOND / (long)fps;
+    long start = Clock_now_ns();
+    long next_frame = start;
+    int32_t ch = 0;
+    while (ch != 'q') {
+        if (dashboard->policy->kind == POLICY_MONTECARLO) {
+            pthread_mutex_lock(&dashboard->lock);
+            size_t playouts = dashboard->stats.playouts;
+            pthread_mutex_unlock(&dashboard->lock);
+            long elapsed_ns = Clock_now_ns() - start;
+            double rate = elapsed_ns > 0 ? (double)playouts * NS_PER_SECOND /
+                                               (double)elapsed_ns
+                                         : 0.0;
+            mvprintw(LINES - 1, 0,
+                     "Autoplaying %zu boards at %zu fps, %.0f playouts/s. "
+                     "Quit with q.",
+                     nr_of_boards, fps, rate);
+            clrtoeol();
+            wnoutrefresh(stdscr);
+        }
+
+        for (size_t b = 0; b < nr_of_boards; ++b) {
+            if (!windows[b] || !views[b]) {
+                continue;
+            }
+            pthread_mutex_lock(&dashboard->boards[b].lock);
+            bool dirty = dashboard->boards[b].dirty;
+            pthread_mutex_unlock(&dashboard->boards[b].lock);
+            if (dirty) {
+                Dashboard_draw_board(windows[b], &dashboard->boards[b],
+                                     views[b], &viewport);
+            }
+        }
+        doupdate();
+
+        // sleep until the next frame is due, waking early for keypresses
+        next_frame += frame_ns;
+        long wait_ns = next_frame - Clock_now_ns();
+        if (wait_ns < 0) {
+            next_frame = Clock_now_ns();
+            wait_ns = 0;
+        }
+        timeout((int)(wait_ns / NS_PER_MS));
+        ch = getch();
+    }
+    timeout(-1);
+
+    for (size_t b = 0; b < nr_of_boards; ++b) {
+        if (windows[b]) {
+            delwin(windows[b]);
+        }
+        GameState_destroy_chain(views[b]);
+    }
+    free(windows);
+    free(views);
+}
+
+// autoplay nr_of_boards games of dimension dim with policy side by side until
+// 'q' is pressed. ncurses must be initialized
+bool Dashboard_run(size_t nr_of_boards, size_t dim, const Policy *policy,
+                   size_t fps) {
+    Dashboard dashboard = {
+        .boards = calloc(nr_of_boards, sizeof(DashboardBoard)),
+        .nr_of_boards = nr_of_boards,
+        .dim = dim,
+        .policy = policy,
+        .stop = false,
+        .stats = {0},
+    };
+    if (!dashboard.boards) {
+        return false;
+    }
+    pthread_mutex_init(&dashboard.lock, NULL);
+
+    bool ok = true;
+    size_t ready = 0;
+    for (; ok && ready < nr_of_boards; ++ready) {
+        DashboardBoard *board = &dashboard.boards[ready];
+        // seeded here, before any worker runs, so every board plays its
+        // own sequence of spawns whatever the thread interleaving
+        board->seed = (unsigned int)rand();
+        board->gs = GameState_create_r(dim, 0, &board->seed);
+        board->tiles = calloc(dim * dim, sizeof(uint32_t));
+        ok = board->gs && board->tiles;
+        pthread_mutex_init(&board->lock, NULL);
+        if (ok) {
+            DashboardBoard_publish(board);
+        }
+    }
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    dashboard.nr_of_workers = cpus > 0 ? (size_t)cpus : 1;
+    if (dashboard.nr_of_workers > nr_of_boards) {
+        dashboard.nr_of_workers = nr_of_boards;
+    }
+    pthread_t *threads = calloc(dashboard.nr_of_workers, sizeof(pthread_t));
+    DashboardWorker *workers =
+        calloc(dashboard.nr_of_workers, sizeof(DashboardWorker));
+    ok = ok && threads && workers;
+
+    size_t started = 0;
+    while (ok && started < dashboard.nr_of_workers) {
+        workers[started] =
+            (DashboardWorker){.dashboard = &dashboard, .worker = started};
+        if (pthread_create(&threads[started], NULL, Dashboard_worker,
+                           &workers[started]) != 0) {
+            break;
+        }
+        started++;
+    }
+    // boards of workers that failed to start are simply left idle
+    ok = ok && started > 0;
+    if (ok) {
+        Dashboard_render(&dashboard, fps);
+    }
+
+    pthread_mutex_lock(&dashboard.lock);
+    dashboard.stop = true;
+    pthread_mutex_unlock(&dashboard.lock);
+    for (size_t i = 0; i < started; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    for (size_t b = 0; b < ready; ++b) {
+        DashboardBoard *board = &dashboard.boards[b];
+        GameState_destroy_chain(board->gs);
+        free(board->tiles);
+        pthread_mutex_destroy(&board->lock);
+    }
+    free(workers);
+    free(threads);
+    pthread_mutex_destroy(&dashboard.lock);
+    free(dashboard.boards);
+    return ok;
+}
+
+#endif // DASHBOARD_C
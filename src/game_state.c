@@ -1,7 +1,11 @@
 #ifndef GAME_STATE_C
 #define GAME_STATE_C
 
+#include "bitset.c"
+#include "profile.c"
+#include "thread_pool.c"
 #include "uint32_array.c"
+#include "undo_journal.c"
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -9,72 +13,184 @@
 #include <stdlib.h>
 #include <sys/types.h>
 
+// boards at least this wide split their lines across the shared thread pool
+#define PARALLEL_DIM_THRESHOLD 256
+
+typedef enum {
+    DIRECTION_LEFT,
+    DIRECTION_RIGHT,
+    DIRECTION_UP,
+    DIRECTION_DOWN,
+} Direction;
+
+// besides the tiles every board keeps one occupancy bitset per row (bit j set
+// if column j holds a tile) followed by one per column (bit i set if row i
+// does), line_words words each, so moves and scans only visit occupied cells
 typedef struct GameState GameState;
 struct GameState {
     UInt32Array tiles;
+    uint64_t *occupancy;
+    size_t line_words;
     size_t dim;
     size_t prev_left;
-    GameState *prev;
+    UndoJournal *journal;
     uint32_t score;
 };
 
+static inline uint64_t *GameState_row_bits(const GameState *gs, size_t row) {
+    return gs->occupancy + (row * gs->line_words);
+}
+
+static inline uint64_t *GameState_col_bits(const GameState *gs, size_t col) {
+    return gs->occupancy + ((gs->dim + col) * gs->line_words);
+}
+
+static void GameState_mark(GameState *gs, size_t i, size_t j, bool occupied) {
+    if (occupied) {
+        Bitset_set(GameState_row_bits(gs, i), j);
+        Bitset_set(GameState_col_bits(gs, j), i);
+    } else {
+        Bitset_clear(GameState_row_bits(gs, i), j);
+        Bitset_clear(GameState_col_bits(gs, j), i);
+    }
+}
+
+// rebuild the occupancy bitsets after writing to gs->tiles directly
+void GameState_sync_occupancy(GameState *gs) {
+    memset(gs->occupancy, 0,
+           2 * gs->dim * gs->line_words * sizeof(uint64_t));
+    for (size_t i = 0; i < gs->dim; ++i) {
+        for (size_t j = 0; j < gs->dim; ++j) {
+            if (gs->tiles.items[(i * gs->dim) + j] != 0) {
+                GameState_mark(gs, i, j, true);
+            }
+        }
+    }
+}
+
 uint32_t GameState_get(const GameState *gs, size_t i, size_t j) {
     return UInt32Array_get(gs->tiles, (i * gs->dim) + j);
 }
 
 bool GameState_set(GameState *gs, size_t i, size_t j, uint32_t val) {
-    return UInt32Array_set(&gs->tiles, (i * gs->dim) + j, val);
+    if (!UInt32Array_set(&gs->tiles, (i * gs->dim) + j, val)) {
+        return false;
+    }
+    GameState_mark(gs, i, j, val != 0);
+    return true;
 }
 
-bool GameState_add_random(GameState *gs) {
-    typedef struct {
-        size_t i;
-        size_t j;
-    } index;
+// run fn over all rows (or columns) of gs, in parallel for large boards
+static void GameState_for_lines(const GameState *gs, ThreadPool_fn fn,
+                                void *ctx) {
+    if (gs->dim >= PARALLEL_DIM_THRESHOLD) {
+        ThreadPool_parallel_for(ThreadPool_shared(), gs->dim, fn, ctx);
+    } else {
+        fn(ctx, 0, gs->dim, 0);
+    }
+}
+
+typedef struct {
+    const GameState *gs;
+    size_t zeros[THREAD_POOL_MAX_THREADS];
+    size_t first_row[THREAD_POOL_MAX_THREADS];
+    size_t last_row[THREAD_POOL_MAX_THREADS];
+} GameState_zero_count;
+
+static void GameState_count_zeros(void *ctx, size_t begin, size_t end,
+                                  size_t slot) {
+    GameState_zero_count *count = ctx;
+    const GameState *gs = count->gs;
+
+    size_t zeros = 0;
+    for (size_t row = begin; row < end; ++row) {
+        zeros += gs->dim -
+                 Bitset_count(GameState_row_bits(gs, row), gs->line_words);
+    }
+    count->zeros[slot] = zeros;
+    count->first_row[slot] = begin;
+    count->last_row[slot] = end;
+}
+
+// the global rand() sequence, or the private one of seed if it is not NULL
+static int GameState_rand(unsigned int *seed) {
+    return seed ? rand_r(seed) : rand();
+}
 
+static bool GameState_spawn_impl(GameState *gs, size_t *index,
+                                 unsigned int *seed) {
     size_t dim = gs->dim;
-    size_t zero_count = 0;
 
-    // count number of empty tiles
-    for (size_t i = 0; i < dim; ++i) {
-        for (size_t j = 0; j < dim; ++j) {
-            if (GameState_get(gs, i, j) == 0) {
-                zero_count++;
-            }
-        }
+    // count number of empty tiles, per chunk of rows
+    GameState_zero_count count = {.gs = gs};
+    GameState_for_lines(gs, GameState_count_zeros, &count);
+
+    size_t zero_count = 0;
+    for (size_t slot = 0; slot < THREAD_POOL_MAX_THREADS; ++slot) {
+        zero_count += count.zeros[slot];
     }
 
     if (zero_count == 0) {
         return false;
     }
 
-    // allocate array for storing empty tile indices
-    index *avail_idxs = malloc(zero_count * sizeof(index));
-    if (!avail_idxs) {
-        return false;
-    }
+    // randomly pick index of empty tiles to add either 2 or 4 to
+    size_t random_idx = GameState_rand(seed) % zero_count;
+    uint32_t value = (GameState_rand(seed) % 10) < 9 ? 2 : 4;
+
+    // find the chunk, then the row holding the chosen empty tile
+    size_t slot = 0;
+    while (random_idx >= count.zeros[slot]) {
+        random_idx -= count.zeros[slot];
+        slot++;
+    }
+
+    for (size_t row = count.first_row[slot]; row < count.last_row[slot];
+         ++row) {
+        const uint64_t *bits = GameState_row_bits(gs, row);
+        size_t zeros = dim - Bitset_count(bits, gs->line_words);
+        if (random_idx >= zeros) {
+            random_idx -= zeros;
+            continue;
+        }
 
-    size_t current_idx = 0;
-    for (size_t i = 0; i < dim; i++) {
-        for (size_t j = 0; j < dim; j++) {
-            if (GameState_get(gs, i, j) == 0) {
-                avail_idxs[current_idx++] = (index){.i = i, .j = j};
-            }
+        size_t col = Bitset_nth_clear(bits, dim, random_idx);
+        GameState_set(gs, row, col, value);
+        UndoJournal_mark_spawn(gs->journal, (row * dim) + col);
+        if (index) {
+            *index = (row * dim) + col;
         }
+        break;
     }
+    return true;
+}
 
-    // randomly pick index of empty tiles to add either 2 or 4 to
-    size_t random_idx = rand() % zero_count;
-    index new_tile = avail_idxs[random_idx];
-    uint32_t value = (rand() % 10) < 9 ? 2 : 4;
-    GameState_set(gs, new_tile.i, new_tile.j, value);
+static bool GameState_spawn(GameState *gs, size_t *index,
+                            unsigned int *seed) {
+    uint64_t start = Profile_begin();
+    bool spawned = GameState_spawn_impl(gs, index, seed);
+    Profile_end(PROFILE_SPAWN, start);
+    return spawned;
+}
 
-    free(avail_idxs);
-    return true;
+// spawn a 2 or 4 on a random empty tile, storing the flat index of that tile
+// in *index if index is not NULL
+bool GameState_add_random_at(GameState *gs, size_t *index) {
+    return GameState_spawn(gs, index, NULL);
 }
 
-GameState *GameState_create(size_t dim, size_t undos) {
+bool GameState_add_random(GameState *gs) {
+    return GameState_add_random_at(gs, NULL);
+}
 
+// like GameState_add_random, but drawing from the rand_r state in *seed so
+// threads can spawn tiles independently and reproducibly
+bool GameState_add_random_r(GameState *gs, unsigned int *seed) {
+    return GameState_spawn(gs, NULL, seed);
+}
+
+// an empty board of dim with undos, for callers that fill in the tiles
+GameState *GameState_create_empty(size_t dim, size_t undos) {
     GameState *game_state = malloc(sizeof(GameState));
     if (game_state == NULL) {
         return NULL;
@@ -86,43 +202,69 @@ GameState *GameState_create(size_t dim, size_t undos) {
         return NULL;
     }
 
+    size_t line_words = Bitset_words(dim);
+    uint64_t *occupancy = calloc(2 * dim * line_words, sizeof(uint64_t));
+    if (!occupancy) {
+        UInt32Array_destroy(&tiles);
+        free(game_state);
+        return NULL;
+    }
+
+    // no history is kept at all when undoing is disabled
+    UndoJournal *journal = NULL;
+    if (undos > 0) {
+        journal = UndoJournal_create();
+        if (!journal) {
+            free(occupancy);
+            UInt32Array_destroy(&tiles);
+            free(game_state);
+            return NULL;
+        }
+    }
+
     *game_state = (GameState){
         .tiles = tiles,
+        .occupancy = occupancy,
+        .line_words = line_words,
         .dim = dim,
         .prev_left = undos,
-        .prev = NULL,
+        .journal = journal,
         .score = 0,
     };
-    GameState_add_random(game_state);
-    GameState_add_random(game_state);
     return game_state;
 }
 
+// like GameState_create, but the two starting tiles are drawn from the
+// rand_r state in *seed, or from rand() if seed is NULL
+GameState *GameState_create_r(size_t dim, size_t undos, unsigned int *seed) {
+    GameState *game_state = GameState_create_empty(dim, undos);
+    if (game_state) {
+        GameState_spawn(game_state, NULL, seed);
+        GameState_spawn(game_state, NULL, seed);
+    }
+    return game_state;
+}
+
+GameState *GameState_create(size_t dim, size_t undos) {
+    return GameState_create_r(dim, undos, NULL);
+}
+
+// frees the board only, any journal still attached to gs is left alone
 void GameState_destroy_single(GameState *gs) {
     UInt32Array_destroy(&gs->tiles);
+    free(gs->occupancy);
     free(gs);
 }
 
+// frees the board together with its undo history
 void GameState_destroy_chain(GameState *gs) {
-    // if (gs) {
-    //     UInt32Array_destroy(gs->tiles);
-    //
-    //     // remove previous GameState chain
-    //     if (gs->previous != NULL) {
-    //         GameState_destroy(gs->previous);
-    //     }
-    //     free(gs);
-    // }
-
-    // better iterative approach
-    while (gs != NULL) {
-        GameState *prev = gs->prev;
+    if (gs) {
+        UndoJournal_destroy(gs->journal);
         GameState_destroy_single(gs);
-        gs = prev;
     }
 }
 
-GameState *GameState_copy(GameState *gs) {
+static GameState *GameState_copy_impl(const GameState *gs) {
     if (gs == NULL) {
         return NULL;
     }
@@ -138,198 +280,272 @@ GameState *GameState_copy(GameState *gs) {
         return NULL;
     }
 
+    size_t occupancy_size = 2 * gs->dim * gs->line_words * sizeof(uint64_t);
+    uint64_t *new_occupancy = malloc(occupancy_size);
+    if (!new_occupancy) {
+        UInt32Array_destroy(&new_tiles);
+        free(copy);
+        return NULL;
+    }
+    memcpy(new_occupancy, gs->occupancy, occupancy_size);
+
     *copy = (GameState){
         .tiles = new_tiles,
+        .occupancy = new_occupancy,
+        .line_words = gs->line_words,
         .dim = gs->dim,
         .prev_left = gs->prev_left,
-        .prev = NULL,
+        .journal = NULL,
         .score = gs->score,
     };
 
     return copy;
 }
 
-void GameState_slide_right(GameState *gs) {
-    size_t dim = gs->dim;
-
-    for (size_t row = 0; row < dim; ++row) {
-        for (size_t i = 0; i < dim - 1; ++i) {
-            size_t col = dim - 2 - i; // this gives dim-2, dim-3, ..., 1, 0
+GameState *GameState_copy(const GameState *gs) {
+    uint64_t start = Profile_begin();
+    GameState *copy = GameState_copy_impl(gs);
+    Profile_end(PROFILE_COPY, start);
+    return copy;
+}
 
-            uint32_t tile = GameState_get(gs, row, col);
-            if (tile == 0) {
-                continue;
-            }
+// one row or column seen from the edge tiles move towards. position p along
+// the line is bit p of its own bitset when walking forwards, or bit dim-1-p
+// when walking backwards
+typedef struct {
+    uint32_t *items;
+    uint64_t *own;
+    uint64_t *cross; // bitsets of the crossing lines, line_words apart
+    size_t line_words;
+    size_t dim;
+    size_t cell0;     // flat index of bit 0
+    size_t cell_step; // flat distance between neighbouring bits
+    size_t cross_bit; // bit of this line in every crossing bitset
+    bool backwards;
+} GameState_line;
+
+static GameState_line GameState_get_line(GameState *gs, Direction dir,
+                                         size_t line) {
+    bool is_row = dir == DIRECTION_LEFT || dir == DIRECTION_RIGHT;
+    return (GameState_line){
+        .items = gs->tiles.items,
+        .own = is_row ? GameState_row_bits(gs, line)
+                      : GameState_col_bits(gs, line),
+        .cross = is_row ? GameState_col_bits(gs, 0) : GameState_row_bits(gs, 0),
+        .line_words = gs->line_words,
+        .dim = gs->dim,
+        .cell0 = is_row ? line * gs->dim : line,
+        .cell_step = is_row ? 1 : gs->dim,
+        .cross_bit = line,
+        .backwards = dir == DIRECTION_RIGHT || dir == DIRECTION_DOWN,
+    };
+}
 
-            size_t target_col = col;
-            while (target_col + 1 < dim &&
-                   GameState_get(gs, row, target_col + 1) == 0) {
-                ++target_col;
-            }
+// next occupied bit at or past position bit in walking order
+static size_t GameState_line_next(const GameState_line *line, size_t bit) {
+    if (line->backwards) {
+        return bit == BITSET_NONE ? BITSET_NONE : Bitset_prev(line->own, bit);
+    }
+    return Bitset_next(line->own, line->line_words, bit);
+}
 
-            if (target_col != col) {
-                GameState_set(gs, row, target_col, tile);
-                GameState_set(gs, row, col, 0);
-            }
-        }
+static void GameState_line_put(GameState_line *line, size_t bit,
+                               uint32_t value) {
+    line->items[line->cell0 + (bit * line->cell_step)] = value;
+    uint64_t *cross = line->cross + (bit * line->line_words);
+    if (value != 0) {
+        Bitset_set(line->own, bit);
+        Bitset_set_atomic(cross, line->cross_bit);
+    } else {
+        Bitset_clear(line->own, bit);
+        Bitset_clear_atomic(cross, line->cross_bit);
     }
 }
 
-uint32_t GameState_merge_right(GameState *gs) {
+// pack the tiles of a line against its edge, merging equal neighbours once
+// (the same as slide, merge, slide). only occupied cells are visited and
+// crossing bitsets are updated atomically, so lines can be compacted in
+// parallel. returns the score gained
+static uint32_t GameState_compact_line(GameState_line *line, bool *changed) {
+    size_t step = line->backwards ? (size_t)-1 : 1;
+    size_t target = line->backwards ? line->dim - 1 : 0;
+    size_t last = BITSET_NONE;
+    uint32_t last_value = 0;
     uint32_t score_add = 0;
-    size_t dim = gs->dim;
 
-    // merge tiles from right to left
-    for (size_t row = 0; row < dim; ++row) {
-        for (size_t col = dim - 1; col > 0; --col) {
-            uint32_t right_tile = GameState_get(gs, row, col);
-            uint32_t left_tile = GameState_get(gs, row, col - 1);
-            if (right_tile == left_tile && right_tile != 0) {
-                uint32_t merged_value = right_tile * 2;
-                GameState_set(gs, row, col, merged_value);
-                GameState_set(gs, row, col - 1, 0);
-                score_add += merged_value;
-            }
+    for (size_t bit = GameState_line_next(line, target); bit != BITSET_NONE;
+         bit = GameState_line_next(line, bit + step)) {
+        uint32_t tile = line->items[line->cell0 + (bit * line->cell_step)];
+        GameState_line_put(line, bit, 0);
+
+        if (last != BITSET_NONE && last_value == tile) {
+            GameState_line_put(line, last, tile * 2);
+            score_add += tile * 2;
+            last = BITSET_NONE;
+            *changed = true;
+            continue;
+        }
+
+        GameState_line_put(line, target, tile);
+        if (target != bit) {
+            *changed = true;
         }
+        last = target;
+        last_value = tile;
+        target += step;
     }
     return score_add;
 }
 
-void GameState_cleanup_old_states(GameState *gs) {
-    if (!gs || gs->prev_left == 0) {
+static void GameState_cleanup_old_states_impl(GameState *gs) {
+    if (!gs || !gs->journal) {
         return;
     }
 
-    size_t remaining = gs->prev_left;
-    GameState *current = gs;
-
-    for (size_t i = 0; i < remaining && current->prev; ++i) {
-        current = current->prev;
+    // history beyond the remaining undos can never be reached again
+    if (gs->prev_left == 0) {
+        UndoJournal_destroy(gs->journal);
+        gs->journal = NULL;
+        return;
     }
 
-    if (current->prev) {
-        GameState_destroy_chain(current->prev);
-        current->prev = NULL;
-    }
+    UndoJournal_trim(gs->journal, gs->prev_left);
 }
 
-GameState *GameState_undo(GameState *gs) {
-    if (!gs || !gs->prev || gs->prev_left == 0) {
-        return NULL;
-    }
-
-    size_t current_prev_left = gs->prev_left;
-    GameState *prev = gs->prev;
-    GameState_destroy_single(gs);
-
-    prev->prev_left = current_prev_left - 1;
-
-    return prev;
+void GameState_cleanup_old_states(GameState *gs) {
+    uint64_t start = Profile_begin();
+    GameState_cleanup_old_states_impl(gs);
+    Profile_end(PROFILE_CLEANUP, start);
 }
 
-bool GameState_equals(const GameState *gs1, const GameState *gs2) {
-    if (!gs1 || !gs2) {
-        return gs1 == gs2;
-    }
-
-    if (gs1->dim != gs2->dim) {
+// false if undoing entry would read past its cells or the board. only a
+// history resumed from a damaged session file can hold such an entry, cell
+// indices past the board are already ignored by GameState_set
+static bool GameState_undo_valid(const GameState *gs, const UndoEntry *entry) {
+    size_t cells_length = gs->journal->cells_length;
+    if (entry->offset > cells_length ||
+        entry->length > cells_length - entry->offset) {
         return false;
     }
-
-    for (size_t row = 0; row < gs1->dim; ++row) {
-        for (size_t col = 0; col < gs1->dim; ++col) {
-            if (GameState_get(gs1, row, col) != GameState_get(gs2, row, col)) {
-                return false;
-            }
-        }
-    }
-    return true;
+    return entry->keyframe ? entry->length == gs->tiles.length
+                           : entry->length % 2 == 0;
 }
 
-GameState *GameState_slide_and_merge_right(GameState *gs) {
-    if (!gs) {
+GameState *GameState_undo(GameState *gs) {
+    if (!gs || gs->prev_left == 0) {
         return NULL;
     }
-
-    GameState *new_gs = GameState_copy(gs);
-    if (!new_gs) {
+    const UndoEntry *entry = UndoJournal_top(gs->journal);
+    if (!entry || !GameState_undo_valid(gs, entry)) {
         return NULL;
     }
 
-    // slide all tiles
-    GameState_slide_right(new_gs);
-
-    // merge tiles and add scores
-    new_gs->score += GameState_merge_right(new_gs);
-
-    // slide again after merging
-    GameState_slide_right(new_gs);
-
-    // check if anything changed
-    if (GameState_equals(gs, new_gs)) {
-        GameState_destroy_chain(new_gs);
-        return NULL;
+    size_t dim = gs->dim;
+    const uint32_t *cells = gs->journal->cells + entry->offset;
+    if (entry->spawn != UNDO_JOURNAL_NO_SPAWN) {
+        GameState_set(gs, entry->spawn / dim, entry->spawn % dim, 0);
+    }
+    if (entry->keyframe) {
+        memcpy(gs->tiles.items, cells, entry->length * sizeof(uint32_t));
+        GameState_sync_occupancy(gs);
+    } else {
+        for (size_t k = 0; k < entry->length; k += 2) {
+            GameState_set(gs, cells[k] / dim, cells[k] % dim, cells[k + 1]);
+        }
     }
+    gs->score -= entry->score_delta;
+    UndoJournal_drop(gs->journal);
 
-    // otherwise valid mode, set correct previous chain
-    new_gs->prev = gs;
-
-    // remove unaccessible previous game states
-    GameState_cleanup_old_states(new_gs);
+    gs->prev_left--;
+    GameState_cleanup_old_states(gs);
 
-    return new_gs;
+    return gs;
 }
 
-void GameState_transpose(GameState *gs) {
-    size_t dim = gs->dim;
-    for (size_t i = 0; i < dim; ++i) {
-        for (size_t j = i + 1; j < dim; ++j) {
-            uint32_t temp = GameState_get(gs, i, j);
-            GameState_set(gs, i, j, GameState_get(gs, j, i));
-            GameState_set(gs, j, i, temp);
+typedef struct {
+    GameState *gs;
+    Direction dir;
+    uint32_t score_add[THREAD_POOL_MAX_THREADS];
+    bool changed[THREAD_POOL_MAX_THREADS];
+} GameState_move;
+
+static void GameState_move_lines(void *ctx, size_t begin, size_t end,
+                                 size_t slot) {
+    uint64_t start = Profile_begin();
+    GameState_move *move = ctx;
+
+    uint32_t score_add = 0;
+    bool changed = false;
+    for (size_t i = begin; i < end; ++i) {
+        // lines are independent, and empty ones have nothing to move
+        GameState_line line = GameState_get_line(move->gs, move->dir, i);
+        if (!Bitset_empty(line.own, line.line_words)) {
+            score_add += GameState_compact_line(&line, &changed);
         }
     }
+    move->score_add[slot] = score_add;
+    move->changed[slot] = changed;
+    Profile_end(PROFILE_COMPACT, start);
 }
 
-void GameState_reverse_rows(GameState *gs) {
-    size_t dim = gs->dim;
-    for (size_t i = 0; i < dim; ++i) {
-        for (size_t j = 0; j < dim / 2; ++j) {
-            uint32_t temp = GameState_get(gs, i, j);
-            GameState_set(gs, i, j, GameState_get(gs, i, dim - 1 - j));
-            GameState_set(gs, i, dim - 1 - j, temp);
-        }
+// journal the cells that differ between gs and new_gs. a cell can only have
+// changed if it is occupied on either board, so only those are compared
+static bool GameState_journal_move_impl(const GameState *gs,
+                                        const GameState *new_gs) {
+    if (!UndoJournal_begin(gs->journal, gs->tiles.length,
+                           new_gs->score - gs->score)) {
+        return false;
     }
-}
 
-void GameState_reverse_cols(GameState *gs) {
-    size_t dim = gs->dim;
-    for (size_t j = 0; j < dim; ++j) {
-        for (size_t i = 0; i < dim / 2; ++i) {
-            uint32_t temp = GameState_get(gs, i, j);
-            GameState_set(gs, i, j, GameState_get(gs, i, dim - 1 - j));
-            GameState_set(gs, i, dim - 1 - j, temp);
+    size_t words = gs->line_words;
+    for (size_t row = 0; row < gs->dim; ++row) {
+        const uint64_t *before = GameState_row_bits(gs, row);
+        const uint64_t *after = GameState_row_bits(new_gs, row);
+        for (size_t w = 0; w < words; ++w) {
+            uint64_t bits = before[w] | after[w];
+            while (bits != 0) {
+                size_t col = (w * BITSET_WORD_BITS) + __builtin_ctzll(bits);
+                bits &= bits - 1;
+
+                size_t idx = (row * gs->dim) + col;
+                if (gs->tiles.items[idx] != new_gs->tiles.items[idx]) {
+                    UndoJournal_add(gs->journal, idx, gs->tiles.items[idx]);
+                }
+            }
         }
     }
-}
 
-void GameState_rotate90(GameState *gs) {
-    GameState_transpose(gs);
-    GameState_reverse_rows(gs);
+    UndoJournal_commit(gs->journal, gs->tiles.items);
+    return true;
 }
 
-void GameState_rotate180(GameState *gs) {
-    GameState_reverse_rows(gs);
-    GameState_reverse_cols(gs);
+static bool GameState_journal_move(const GameState *gs,
+                                   const GameState *new_gs) {
+    uint64_t start = Profile_begin();
+    bool journaled = GameState_journal_move_impl(gs, new_gs);
+    Profile_end(PROFILE_JOURNAL, start);
+    return journaled;
 }
 
-void GameState_rotate270(GameState *gs) {
-    GameState_reverse_rows(gs);
-    GameState_transpose(gs);
+// slide and merge every line of gs in place, adding the merges to its score.
+// returns false, leaving gs as it was, if nothing moved. the undo history is
+// not touched
+bool GameState_slide_and_merge_in_place(GameState *gs, Direction dir) {
+    uint64_t start = Profile_begin();
+    GameState_move move = {.gs = gs, .dir = dir};
+    GameState_for_lines(gs, GameState_move_lines, &move);
+    bool changed = false;
+    for (size_t slot = 0; slot < THREAD_POOL_MAX_THREADS; ++slot) {
+        gs->score += move.score_add[slot];
+        changed = changed || move.changed[slot];
+    }
+    Profile_end(PROFILE_MOVE, start);
+    return changed;
 }
 
-GameState *GameState_slide_and_merge_left(GameState *gs) {
-
+// on success the returned state takes over the undo history of gs and gs
+// itself is freed; if nothing moved NULL is returned and gs is left untouched
+GameState *GameState_slide_and_merge(GameState *gs, Direction dir) {
     if (!gs) {
         return NULL;
     }
@@ -339,18 +555,21 @@ GameState *GameState_slide_and_merge_left(GameState *gs) {
         return NULL;
     }
 
-    GameState_rotate180(new_gs);
-    GameState_slide_right(new_gs);
-    new_gs->score += GameState_merge_right(new_gs);
-    GameState_slide_right(new_gs);
-    GameState_rotate180(new_gs);
-
-    if (GameState_equals(gs, new_gs)) {
+    if (!GameState_slide_and_merge_in_place(new_gs, dir)) {
         GameState_destroy_chain(new_gs);
         return NULL;
     }
 
-    new_gs->prev = gs;
+    // otherwise valid move, journal what changed and hand the history over
+    if (gs->journal && gs->prev_left > 0) {
+        if (!GameState_journal_move(gs, new_gs)) {
+            GameState_destroy_chain(new_gs);
+            return NULL;
+        }
+    }
+    new_gs->journal = gs->journal;
+    gs->journal = NULL;
+    GameState_destroy_single(gs);
 
     // remove unaccessible previous game states
     GameState_cleanup_old_states(new_gs);
@@ -358,87 +577,70 @@ GameState *GameState_slide_and_merge_left(GameState *gs) {
     return new_gs;
 }
 
-GameState *GameState_slide_and_merge_up(GameState *gs) {
-    if (!gs) {
-        return NULL;
-    }
-
-    GameState *new_gs = GameState_copy(gs);
-    if (!new_gs) {
-        return NULL;
-    }
-
-    GameState_rotate90(new_gs);
-    GameState_slide_right(new_gs);
-    new_gs->score += GameState_merge_right(new_gs);
-    GameState_slide_right(new_gs);
-    GameState_rotate270(new_gs);
-
-    if (GameState_equals(gs, new_gs)) {
-        GameState_destroy_chain(new_gs);
-        return NULL;
-    }
-
-    new_gs->prev = gs;
+GameState *GameState_slide_and_merge_right(GameState *gs) {
+    return GameState_slide_and_merge(gs, DIRECTION_RIGHT);
+}
 
-    // remove unaccessible previous game states
-    GameState_cleanup_old_states(new_gs);
+GameState *GameState_slide_and_merge_left(GameState *gs) {
+    return GameState_slide_and_merge(gs, DIRECTION_LEFT);
+}
 
-    return new_gs;
+GameState *GameState_slide_and_merge_up(GameState *gs) {
+    return GameState_slide_and_merge(gs, DIRECTION_UP);
 }
 
 GameState *GameState_slide_and_merge_down(GameState *gs) {
-    if (!gs) {
-        return NULL;
-    }
-
-    GameState *new_gs = GameState_copy(gs);
-    if (!new_gs) {
-        return NULL;
-    }
-
-    GameState_rotate270(new_gs);
-    GameState_slide_right(new_gs);
-    new_gs->score += GameState_merge_right(new_gs);
-    GameState_slide_right(new_gs);
-    GameState_rotate90(new_gs);
-
-    if (GameState_equals(gs, new_gs)) {
-        GameState_destroy_chain(new_gs);
-        return NULL;
-    }
+    return GameState_slide_and_merge(gs, DIRECTION_DOWN);
+}
 
-    new_gs->prev = gs;
+typedef struct {
+    const GameState *gs;
+    bool movable[THREAD_POOL_MAX_THREADS];
+} GameState_move_check;
 
-    // remove unaccessible previous game states
-    GameState_cleanup_old_states(new_gs);
+static void GameState_check_rows(void *ctx, size_t begin, size_t end,
+                                 size_t slot) {
+    GameState_move_check *check = ctx;
+    const GameState *gs = check->gs;
+    const uint32_t *items = gs->tiles.items;
+    size_t dim = gs->dim;
 
-    return new_gs;
-}
+    for (size_t row = begin; row < end; ++row) {
+        // any row that is not full has an empty tile to move into
+        if (Bitset_count(GameState_row_bits(gs, row), gs->line_words) < dim) {
+            check->movable[slot] = true;
+            return;
+        }
 
-bool GameState_can_move(GameState *gs) {
-    size_t dim = gs->dim;
-    for (size_t row = 0; row < dim; ++row) {
         for (size_t col = 0; col < dim; ++col) {
-            uint32_t current = GameState_get(gs, row, col);
-
-            if (current == 0) {
-                return true;
-            }
+            uint32_t current = items[(row * dim) + col];
 
             // check if current tile can merge with right neighbour
-            if (col < dim - 1 && current == GameState_get(gs, row, col + 1)) {
-                return true;
+            if (col < dim - 1 && current == items[(row * dim) + col + 1]) {
+                check->movable[slot] = true;
+                return;
             }
 
             // check if current tile can merge with bottom
-            if (row < dim - 1 && current == GameState_get(gs, row + 1, col)) {
-                return true;
+            if (row < dim - 1 && current == items[((row + 1) * dim) + col]) {
+                check->movable[slot] = true;
+                return;
             }
         }
     }
-    // no merges or moves possible
-    return false;
+}
+
+bool GameState_can_move(GameState *gs) {
+    uint64_t start = Profile_begin();
+    GameState_move_check check = {.gs = gs};
+    GameState_for_lines(gs, GameState_check_rows, &check);
+    // no merges or moves possible unless some chunk found one
+    bool movable = false;
+    for (size_t slot = 0; slot < THREAD_POOL_MAX_THREADS; ++slot) {
+        movable = movable || check.movable[slot];
+    }
+    Profile_end(PROFILE_CAN_MOVE, start);
+    return movable;
 }
 
 #endif // GAME_STATE_C
@@ -1,5 +1,10 @@
+#include "analysis.c"
+#include "dashboard.c"
 #include "game_state.c"
 #include "render.c"
+#include "replay.c"
+#include "replay_viewer.c"
+#include "session.c"
 #include <locale.h>
 #include <ncurses.h>
 #include <stdint.h>
@@ -22,6 +27,16 @@ int32_t parse_positive(const char *s, int32_t min) {
 int main(int32_t argc, char *argv[]) {
     int dimension = DEFAULT_DIMENSION;
     int undos = DEFAULT_UNDOS;
+    const char *record_path = NULL;
+    const char *watch_path = NULL;
+    const char *analyze_path = NULL;
+    const char *session_path = NULL;
+    int depth = SEARCH_DEFAULT_DEPTH;
+    PolicyKind policy_kind = POLICY_EXPECTIMAX;
+    int budget = MONTECARLO_DEFAULT_BUDGET_MS;
+    int boards = 0;
+    int fps = DASHBOARD_DEFAULT_FPS;
+    bool profile = false;
 
     // command line arguments
     for (size_t i = 1; i < argc; ++i) {
@@ -45,14 +60,114 @@ int main(int32_t argc, char *argv[]) {
             }
             undos = val;
             ++i;
+        } else if ((strcmp(argv[i], "-r") == 0 ||
+                    strcmp(argv[i], "--record") == 0) &&
+                   i + 1 < argc) {
+            record_path = argv[i + 1];
+            ++i;
+        } else if ((strcmp(argv[i], "-w") == 0 ||
+                    strcmp(argv[i], "--watch") == 0) &&
+                   i + 1 < argc) {
+            watch_path = argv[i + 1];
+            ++i;
+        } else if ((strcmp(argv[i], "-a") == 0 ||
+                    strcmp(argv[i], "--analyze") == 0) &&
+                   i + 1 < argc) {
+            analyze_path = argv[i + 1];
+            ++i;
+        } else if ((strcmp(argv[i], "-s") == 0 ||
+                    strcmp(argv[i], "--session") == 0) &&
+                   i + 1 < argc) {
+            session_path = argv[i + 1];
+            ++i;
+        } else if (strcmp(argv[i], "--depth") == 0 && i + 1 < argc) {
+            int val = parse_positive(argv[i + 1], 1);
+            if (val == -1) {
+                fprintf(stderr, "Error: Depth must be an integer > 0\n");
+                return 1;
+            }
+            depth = val;
+            ++i;
+        } else if (strcmp(argv[i], "--policy") == 0 && i + 1 < argc) {
+            if (!Policy_parse(argv[i + 1], &policy_kind)) {
+                fprintf(stderr, "Error: Policy must be expectimax or "
+                                "montecarlo\n");
+                return 1;
+            }
+            ++i;
+        } else if (strcmp(argv[i], "--budget") == 0 && i + 1 < argc) {
+            int val = parse_positive(argv[i + 1], 1);
+            if (val == -1) {
+                fprintf(stderr, "Error: Budget must be an integer > 0\n");
+                return 1;
+            }
+            budget = val;
+            ++i;
+        } else if ((strcmp(argv[i], "-D") == 0 ||
+                    strcmp(argv[i], "--dashboard") == 0) &&
+                   i + 1 < argc) {
+            int val = parse_positive(argv[i + 1], 1);
+            if (val == -1) {
+                fprintf(stderr, "Error: Boards must be an integer > 0\n");
+                return 1;
+            }
+            boards = val;
+            ++i;
+        } else if (strcmp(argv[i], "--profile") == 0) {
+            profile = true;
+        } else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+            int val = parse_positive(argv[i + 1], 1);
+            if (val == -1) {
+                fprintf(stderr, "Error: FPS must be an integer > 0\n");
+                return 1;
+            }
+            fps = val;
+            ++i;
         } else {
             fprintf(stderr, "Unknown argument: %s\n", argv[i]);
             fprintf(stderr,
-                    "Usage: %s [-d n | --dimension n] [-u n | --undos n]\n",
+                    "Usage: %s [-d n | --dimension n] [-u n | --undos n] "
+                    "[-r file | --record file] [-w file | --watch file] "
+                    "[-s file | --session file] [-a file | --analyze file] "
+                    "[--depth n] [--policy name] [--budget ms] "
+                    "[-D n | --dashboard n] [--fps n] [--profile]\n",
                     argv[0]);
             return 1;
         }
     }
+
+    if (profile) {
+        Profile_report_at_exit();
+    }
+
+    Policy policy = {
+        .kind = policy_kind,
+        .depth = depth,
+        .budget_ns = budget * NS_PER_MS,
+    };
+
+    // analysis is headless, it never touches the terminal
+    if (analyze_path) {
+        Replay *replay = Replay_load(analyze_path);
+        if (!replay) {
+            fprintf(stderr, "Error: Could not load replay '%s'\n",
+                    analyze_path);
+            return 1;
+        }
+        bool ok = Analysis_run(replay, &policy, stdout);
+        Replay_destroy(replay);
+        return ok ? 0 : 1;
+    }
+
+    Replay *replay = NULL;
+    if (watch_path) {
+        replay = Replay_load(watch_path);
+        if (!replay) {
+            fprintf(stderr, "Error: Could not load replay '%s'\n",
+                    watch_path);
+            return 1;
+        }
+    }
     // set locale for unicode support
     setlocale(LC_ALL, "");
 
@@ -62,8 +177,46 @@ int main(int32_t argc, char *argv[]) {
     noecho();             // don't echo pressed keys
     keypad(stdscr, TRUE); // enable special keys
 
+    if (replay) {
+        Replay_watch(replay);
+        endwin();
+        Replay_destroy(replay);
+        return 0;
+    }
+
     srand(time(NULL));
-    GameState *gs = GameState_create(dimension, undos);
+
+    if (boards > 0) {
+        bool ok = Dashboard_run(boards, dimension, &policy, fps);
+        endwin();
+        return ok ? 0 : 1;
+    }
+    GameState *gs = NULL;
+    Session *session = NULL;
+    if (session_path) {
+        session = Session_open(session_path, dimension, undos, &gs);
+        if (!session) {
+            endwin();
+            fprintf(stderr, "Error: Could not open session '%s'\n",
+                    session_path);
+            return 1;
+        }
+    } else {
+        gs = GameState_create(dimension, undos);
+    }
+
+    FILE *record = NULL;
+    if (record_path) {
+        record = Replay_record_open(record_path, gs);
+        if (!record) {
+            endwin();
+            fprintf(stderr, "Error: Could not open '%s' for recording\n",
+                    record_path);
+            GameState_destroy_chain(gs);
+            Session_close(session);
+            return 1;
+        }
+    }
 
     // clear screen and print initial state
     clear();
@@ -77,6 +230,7 @@ int main(int32_t argc, char *argv[]) {
 
     printw("╭╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╮\n");
     printw("╎ Undo with:     u, z, space.   ╎\n");
+    printw("╎ Pan/zoom with: H J K L, c.    ╎\n");
     printw("╰╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╯\n");
     refresh();
 
@@ -85,6 +239,7 @@ int main(int32_t argc, char *argv[]) {
     bool exit = false;
 
     bool last_move_was_undo = false;
+    Direction dir = DIRECTION_LEFT;
     GameState *new_gs = NULL;
     while (!exit && (ch = getch()) != 'q') {
         last_move_was_undo = false;
@@ -93,21 +248,25 @@ int main(int32_t argc, char *argv[]) {
         case KEY_LEFT:
         case 'a':
         case 'h':
+            dir = DIRECTION_LEFT;
             new_gs = GameState_slide_and_merge_left(gs);
             break;
         case KEY_DOWN:
         case 's':
         case 'j':
+            dir = DIRECTION_DOWN;
             new_gs = GameState_slide_and_merge_down(gs);
             break;
         case KEY_UP:
         case 'w':
         case 'k':
+            dir = DIRECTION_UP;
             new_gs = GameState_slide_and_merge_up(gs);
             break;
         case KEY_RIGHT:
         case 'd':
         case 'l':
+            dir = DIRECTION_RIGHT;
             new_gs = GameState_slide_and_merge_right(gs);
             break;
         case 'u':
@@ -116,6 +275,25 @@ int main(int32_t argc, char *argv[]) {
             new_gs = GameState_undo(gs);
             last_move_was_undo = true;
             break;
+        case KEY_SLEFT:
+        case 'H':
+            GameState_pan(0, -1);
+            break;
+        case KEY_SF:
+        case 'J':
+            GameState_pan(1, 0);
+            break;
+        case KEY_SR:
+        case 'K':
+            GameState_pan(-1, 0);
+            break;
+        case KEY_SRIGHT:
+        case 'L':
+            GameState_pan(0, 1);
+            break;
+        case 'c':
+            GameState_toggle_compact();
+            break;
         default:
             printw("unknown key '%c'\n", ch);
             break;
@@ -124,10 +302,16 @@ int main(int32_t argc, char *argv[]) {
         // if change occured
         if (new_gs) {
             if (!last_move_was_undo) {
-                game_over = !GameState_add_random(new_gs) ||
+                size_t spawn = REPLAY_NO_SPAWN;
+                game_over = !GameState_add_random_at(new_gs, &spawn) ||
                             !GameState_can_move(new_gs);
+                Replay_record_move(record, dir, new_gs, spawn);
+            } else {
+                Replay_record_board(record, new_gs);
             }
+            Session_sync(session, new_gs);
             gs = new_gs;
+            new_gs = NULL;
         }
 
         // clear screen and redraw
@@ -150,8 +334,12 @@ int main(int32_t argc, char *argv[]) {
                 if (re == 'q') {
                     exit = true;
                 } else { // if undoing, undo and redraw
-                    gs = GameState_undo(gs);
-                    game_over = false;
+                    // undo refuses a damaged entry from a resumed session
+                    if (GameState_undo(gs)) {
+                        Replay_record_board(record, gs);
+                        Session_sync(session, gs);
+                        game_over = false;
+                    }
                     clear();
                     GameState_print(gs);
                     refresh();
@@ -170,5 +358,9 @@ int main(int32_t argc, char *argv[]) {
     endwin();
     // cleanup game state
     GameState_destroy_chain(gs);
+    if (record) {
+        fclose(record);
+    }
+    Session_close(session);
     return 0;
 }
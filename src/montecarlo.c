@@ -0,0 +1,161 @@
+#ifndef MONTECARLO_C
+#define MONTECARLO_C
+
+#include "clock.c"
+#include "game_state.c"
+#include "search.c"
+#include "thread_pool.c"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MONTECARLO_DEFAULT_BUDGET_MS 100
+// playouts per legal first move and thread in one batch
+#define MONTECARLO_BATCH_PER_THREAD 2
+// playouts end when the game does or after this many moves, so a single
+// batch stays short on big boards
+#define MONTECARLO_PLAYOUT_LIMIT 1000
+#define MONTECARLO_SEED_MIX 0x9e3779b9u
+
+typedef struct {
+    size_t playouts;
+    long elapsed_ns;
+} MonteCarloStats;
+
+typedef struct {
+    GameState *children[SEARCH_NR_OF_DIRECTIONS];
+    Direction legal[SEARCH_NR_OF_DIRECTIONS];
+    size_t nr_of_legal;
+    unsigned int seed;
+    long deadline;
+    size_t playouts[THREAD_POOL_MAX_THREADS]; // run by each slot this batch
+    double total[THREAD_POOL_MAX_THREADS][SEARCH_NR_OF_DIRECTIONS];
+    size_t count[THREAD_POOL_MAX_THREADS][SEARCH_NR_OF_DIRECTIONS];
+} MonteCarlo_batch;
+
+// play random moves from gs until the game ends or deadline passes,
+// returning the final score. gs is consumed
+static uint32_t MonteCarlo_playout(GameState *gs, unsigned int *seed,
+                                   long deadline) {
+    for (size_t moves = 0; moves < MONTECARLO_PLAYOUT_LIMIT; ++moves) {
+        if (Clock_now_ns() >= deadline || !GameState_add_random_r(gs, seed)) {
+            break;
+        }
+
+        // try the directions starting from a random one
+        size_t start = rand_r(seed) % SEARCH_NR_OF_DIRECTIONS;
+        GameState *next = NULL;
+        for (size_t d = 0; !next && d < SEARCH_NR_OF_DIRECTIONS; ++d) {
+            Direction dir = (Direction)((start + d) % SEARCH_NR_OF_DIRECTIONS);
+            next = GameState_slide_and_merge(gs, dir);
+        }
+        if (!next) {
+            break;
+        }
+        gs = next;
+    }
+
+    uint32_t score = gs->score;
+    GameState_destroy_chain(gs);
+    return score;
+}
+
+static void MonteCarlo_run_batch(void *ctx, size_t begin, size_t end,
+                                 size_t slot) {
+    MonteCarlo_batch *batch = ctx;
+    for (size_t i = begin; i < end; ++i) {
+        // the rest of the batch is skipped once the budget is spent, but
+        // every legal move keeps at least one playout
+        if (i >= batch->nr_of_legal && Clock_now_ns() >= batch->deadline) {
+            break;
+        }
+        size_t d = batch->legal[i % batch->nr_of_legal];
+        GameState *copy = GameState_copy(batch->children[d]);
+        if (!copy) {
+            continue;
+        }
+        // every playout gets its own stream, whichever thread runs it
+        unsigned int seed =
+            batch->seed ^ ((unsigned int)i * MONTECARLO_SEED_MIX);
+        batch->total[slot][d] +=
+            MonteCarlo_playout(copy, &seed, batch->deadline);
+        batch->count[slot][d]++;
+        batch->playouts[slot]++;
+    }
+}
+
+// rank the moves from gs by the mean final score of random playouts after
+// each of them. playouts run in batches on the shared thread pool until
+// budget_ns has passed, which also cuts short the batch and playouts still
+// running then. seed is advanced once per batch. if stats is not NULL the
+// playouts and time are added to it
+SearchResult MonteCarlo_evaluate(const GameState *gs, long budget_ns,
+                                 unsigned int *seed, MonteCarloStats *stats) {
+    SearchResult result = {.best = DIRECTION_LEFT, .can_move = false};
+    MonteCarlo_batch *batch = calloc(1, sizeof(MonteCarlo_batch));
+    if (!batch) {
+        return result;
+    }
+
+    for (size_t d = 0; d < SEARCH_NR_OF_DIRECTIONS; ++d) {
+        batch->children[d] = Search_child(gs, (Direction)d);
+        if (batch->children[d]) {
+            batch->legal[batch->nr_of_legal++] = (Direction)d;
+        }
+    }
+
+    // a busy pool runs the batch inline, so batches are sized for the
+    // threads the previous one actually ran on, starting from one
+    ThreadPool *pool = ThreadPool_shared();
+    size_t threads = 1;
+    long start = Clock_now_ns();
+    batch->deadline = start + budget_ns;
+    size_t playouts = 0;
+    if (batch->nr_of_legal > 0) {
+        do {
+            size_t n =
+                batch->nr_of_legal * threads * MONTECARLO_BATCH_PER_THREAD;
+            batch->seed = rand_r(seed);
+            memset(batch->playouts, 0, sizeof(batch->playouts));
+            ThreadPool_parallel_for(pool, n, MonteCarlo_run_batch, batch);
+
+            threads = 0;
+            for (size_t slot = 0; slot < THREAD_POOL_MAX_THREADS; ++slot) {
+                playouts += batch->playouts[slot];
+                threads += batch->playouts[slot] > 0;
+            }
+            if (threads == 0) {
+                threads = 1;
+            }
+        } while (Clock_now_ns() < batch->deadline);
+    }
+
+    for (size_t k = 0; k < batch->nr_of_legal; ++k) {
+        Direction d = batch->legal[k];
+        double total = 0.0;
+        size_t count = 0;
+        for (size_t slot = 0; slot < THREAD_POOL_MAX_THREADS; ++slot) {
+            total += batch->total[slot][d];
+            count += batch->count[slot][d];
+        }
+
+        result.legal[d] = true;
+        result.value[d] = count > 0 ? total / (double)count : 0.0;
+        if (!result.can_move || result.value[d] > result.value[result.best]) {
+            result.best = d;
+        }
+        result.can_move = true;
+        GameState_destroy_chain(batch->children[d]);
+    }
+
+    if (stats) {
+        stats->playouts += playouts;
+        stats->elapsed_ns += Clock_now_ns() - start;
+    }
+    free(batch);
+    return result;
+}
+
+#endif // MONTECARLO_C
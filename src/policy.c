@@ -0,0 +1,50 @@
+#ifndef POLICY_C
+#define POLICY_C
+
+#include "game_state.c"
+#include "montecarlo.c"
+#include "search.c"
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+typedef enum {
+    POLICY_EXPECTIMAX,
+    POLICY_MONTECARLO,
+    POLICY_NR_OF_KINDS,
+} PolicyKind;
+
+static const char *const policy_names[POLICY_NR_OF_KINDS] = {
+    [POLICY_EXPECTIMAX] = "expectimax",
+    [POLICY_MONTECARLO] = "montecarlo",
+};
+
+// how autoplay and analysis pick moves
+typedef struct {
+    PolicyKind kind;
+    size_t depth;   // expectimax search depth
+    long budget_ns; // monte carlo time per move
+} Policy;
+
+// look up a policy by name, false if there is none
+bool Policy_parse(const char *name, PolicyKind *kind) {
+    for (size_t k = 0; k < POLICY_NR_OF_KINDS; ++k) {
+        if (strcmp(name, policy_names[k]) == 0) {
+            *kind = (PolicyKind)k;
+            return true;
+        }
+    }
+    return false;
+}
+
+// value every move from gs with policy. seed is the rand_r state used by
+// monte carlo playouts, whose work is added to stats if it is not NULL
+SearchResult Policy_evaluate(const Policy *policy, const GameState *gs,
+                             unsigned int *seed, MonteCarloStats *stats) {
+    if (policy->kind == POLICY_MONTECARLO) {
+        return MonteCarlo_evaluate(gs, policy->budget_ns, seed, stats);
+    }
+    return Search_evaluate(gs, policy->depth);
+}
+
+#endif // POLICY_C
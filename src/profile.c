@@ -0,0 +1,147 @@
+#ifndef PROFILE_C
+#define PROFILE_C
+
+#include "clock.c"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// engine counters, always compiled in. every thread counts into its own
+// block, so the hot path is a pair of timestamps and a few plain adds
+typedef enum {
+    PROFILE_COPY,
+    PROFILE_MOVE,
+    PROFILE_COMPACT,
+    PROFILE_JOURNAL,
+    PROFILE_CAN_MOVE,
+    PROFILE_SPAWN,
+    PROFILE_CLEANUP,
+    PROFILE_NR_OF_COUNTERS,
+} ProfileCounter;
+
+static const char *const profile_names[PROFILE_NR_OF_COUNTERS] = {
+    [PROFILE_COPY] = "copy",         [PROFILE_MOVE] = "slide_and_merge",
+    [PROFILE_COMPACT] = "compact",   [PROFILE_JOURNAL] = "journal",
+    [PROFILE_CAN_MOVE] = "can_move", [PROFILE_SPAWN] = "spawn",
+    [PROFILE_CLEANUP] = "cleanup",
+};
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PROFILE_TICK_UNIT "cycles"
+#else
+#define PROFILE_TICK_UNIT "ns"
+#endif
+
+typedef struct ProfileBlock ProfileBlock;
+struct ProfileBlock {
+    uint64_t calls[PROFILE_NR_OF_COUNTERS];
+    uint64_t ticks[PROFILE_NR_OF_COUNTERS];
+    uint64_t bytes_allocated;
+    uint64_t bytes_freed;
+    ProfileBlock *next;
+};
+
+// blocks of every thread that ever counted anything, including threads that
+// have exited since. only read once the other threads are done
+static pthread_mutex_t profile_lock = PTHREAD_MUTEX_INITIALIZER;
+static ProfileBlock *profile_blocks = NULL;
+static __thread ProfileBlock *profile_block = NULL;
+
+static ProfileBlock *Profile_block(void) {
+    if (!profile_block) {
+        ProfileBlock *block = calloc(1, sizeof(ProfileBlock));
+        if (!block) {
+            return NULL;
+        }
+        pthread_mutex_lock(&profile_lock);
+        block->next = profile_blocks;
+        profile_blocks = block;
+        pthread_mutex_unlock(&profile_lock);
+        profile_block = block;
+    }
+    return profile_block;
+}
+
+static inline uint64_t Profile_ticks(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    return (uint64_t)Clock_now_ns();
+#endif
+}
+
+// timestamp to hand to Profile_end when the counted call returns
+static inline uint64_t Profile_begin(void) { return Profile_ticks(); }
+
+static inline void Profile_end(ProfileCounter counter, uint64_t begin) {
+    uint64_t ticks = Profile_ticks() - begin;
+    ProfileBlock *block = Profile_block();
+    if (block) {
+        block->calls[counter]++;
+        block->ticks[counter] += ticks;
+    }
+}
+
+static inline void Profile_alloc(size_t bytes) {
+    ProfileBlock *block = Profile_block();
+    if (block) {
+        block->bytes_allocated += bytes;
+    }
+}
+
+static inline void Profile_free(size_t bytes) {
+    ProfileBlock *block = Profile_block();
+    if (block) {
+        block->bytes_freed += bytes;
+    }
+}
+
+// per function totals over all threads. times are inclusive, e.g. the
+// compact passes inside a slide_and_merge count towards both. compact is
+// the pass that slides and merges a chunk of lines at once, counted once
+// per chunk on the thread that ran it
+void Profile_report(FILE *out) {
+    uint64_t calls[PROFILE_NR_OF_COUNTERS] = {0};
+    uint64_t ticks[PROFILE_NR_OF_COUNTERS] = {0};
+    uint64_t allocated = 0;
+    uint64_t freed = 0;
+    size_t threads = 0;
+
+    pthread_mutex_lock(&profile_lock);
+    for (const ProfileBlock *block = profile_blocks; block;
+         block = block->next) {
+        for (size_t c = 0; c < PROFILE_NR_OF_COUNTERS; ++c) {
+            calls[c] += block->calls[c];
+            ticks[c] += block->ticks[c];
+        }
+        allocated += block->bytes_allocated;
+        freed += block->bytes_freed;
+        threads++;
+    }
+    pthread_mutex_unlock(&profile_lock);
+
+    fprintf(out, "%-16s %12s %16s %12s\n", "function", "calls",
+            PROFILE_TICK_UNIT, "per call");
+    // leave out what this run never called, e.g. the journal without undos
+    for (size_t c = 0; c < PROFILE_NR_OF_COUNTERS; ++c) {
+        if (calls[c] == 0) {
+            continue;
+        }
+        fprintf(out, "%-16s %12llu %16llu %12.1f\n", profile_names[c],
+                (unsigned long long)calls[c], (unsigned long long)ticks[c],
+                (double)ticks[c] / (double)calls[c]);
+    }
+    fprintf(out, "tile arrays: %llu bytes allocated, %llu bytes freed\n",
+            (unsigned long long)allocated, (unsigned long long)freed);
+    fprintf(out, "counted on %zu threads\n", threads);
+}
+
+static void Profile_report_stderr(void) { Profile_report(stderr); }
+
+// print the report to stderr when the process exits
+void Profile_report_at_exit(void) { atexit(Profile_report_stderr); }
+
+#endif // PROFILE_C
@@ -5,11 +5,22 @@
 #define NR_OF_COLORS 14
 #define LIGHT_THRES 8
 #define TILE_STRING_BUF_SIZE 16
+#define TILE_UNIT 1024
+#define CELL_W 7
+#define CELL_H 3
+#define COMPACT_CELL_W 5
+#define COMPACT_CELL_H 1
+#define HEADER_WIDTH 33
+#define HEADER_HEIGHT 3
+#define STATUS_HEIGHT 2
 
 #include "game_state.c"
 #include <ncurses.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 static void ensure_colors_initialized(void) {
     static bool initiated = false;
@@ -63,130 +74,306 @@ static uint8_t pair_for_value(uint32_t value) {
     return NR_OF_COLORS + 1;
 }
 
-void GameState_print(GameState *gs) {
-    if (!gs) {
-        printw("Game state is NULL\n");
-        return;
+// part of the board that is shown when it does not fit where it is drawn.
+// row and col are the top left visible tile, compact shrinks every cell to a
+// single line of COMPACT_CELL_W columns
+typedef struct {
+    size_t row;
+    size_t col;
+    bool compact;
+} Viewport;
+
+// viewport of GameState_print, moved with GameState_pan and
+// GameState_toggle_compact
+static Viewport screen_viewport = {.row = 0, .col = 0, .compact = false};
+
+static int cell_width(bool compact) {
+    return compact ? COMPACT_CELL_W : CELL_W;
+}
+
+static int cell_height(bool compact) {
+    return compact ? COMPACT_CELL_H : CELL_H;
+}
+
+// number of screen lines a fully visible board of dim takes
+int GameState_print_height(size_t dim, bool compact) {
+    return HEADER_HEIGHT + ((int)dim * (cell_height(compact) + 1)) + 1;
+}
+
+// number of screen columns a fully visible board of dim takes
+int GameState_print_width(size_t dim, bool compact) {
+    int grid_w = ((int)dim * (cell_width(compact) + 1)) + 1;
+    return grid_w > HEADER_WIDTH ? grid_w : HEADER_WIDTH;
+}
+
+void GameState_pan(long rows, long cols) {
+    long row = (long)screen_viewport.row + rows;
+    long col = (long)screen_viewport.col + cols;
+    // the upper bound depends on the board and screen, it is applied when
+    // the board is drawn
+    screen_viewport.row = row > 0 ? (size_t)row : 0;
+    screen_viewport.col = col > 0 ? (size_t)col : 0;
+}
+
+void GameState_toggle_compact(void) {
+    screen_viewport.compact = !screen_viewport.compact;
+}
+
+// scratch pad every board is composed on before being copied to its window,
+// only ever as large as the part of the board that is visible
+static WINDOW *render_pad = NULL;
+static int render_pad_h = 0;
+static int render_pad_w = 0;
+
+static WINDOW *get_render_pad(int height, int width) {
+    if (!render_pad || height > render_pad_h || width > render_pad_w) {
+        if (render_pad) {
+            delwin(render_pad);
+        }
+        render_pad_h = height > render_pad_h ? height : render_pad_h;
+        render_pad_w = width > render_pad_w ? width : render_pad_w;
+        render_pad = newpad(render_pad_h, render_pad_w);
     }
+    if (render_pad) {
+        werase(render_pad);
+    }
+    return render_pad;
+}
 
-    ensure_colors_initialized();
+// line buffer, large enough for one composed line of the visible grid
+static char *render_line = NULL;
+static size_t render_line_size = 0;
 
-    const size_t dim = gs->dim;
-    const int cell_w = 7;
-    const int cell_h = 3;
+static char *get_render_line(size_t size) {
+    if (size > render_line_size) {
+        char *line = realloc(render_line, size);
+        if (!line) {
+            return NULL;
+        }
+        render_line = line;
+        render_line_size = size;
+    }
+    return render_line;
+}
 
-    printw("\n");
-    printw("╭───────────────────────────────╮\n");
-    printw("│ Score: %-10u", gs->score);
-    if (gs->prev_left != 0) {
-        printw("  Undos: %-3zu │\n", gs->prev_left);
-    } else {
-        printw("             │\n");
+static size_t append(char *buf, size_t len, const char *str) {
+    size_t n = strlen(str);
+    memcpy(buf + len, str, n + 1);
+    return len + n;
+}
+
+// write value into tile, scaled down by TILE_UNIT with a k, M or G suffix
+// until it fits in width columns, e.g. 131072 becomes 128k
+static int tile_label(char *tile, size_t size, uint32_t value, int width) {
+    static const char suffixes[] = "kMG";
+    int tile_len = snprintf(tile, size, "%u", value);
+    for (size_t s = 0; tile_len > width && s < sizeof(suffixes) - 1; ++s) {
+        value /= TILE_UNIT;
+        tile_len = snprintf(tile, size, "%u%c", value, suffixes[s]);
     }
-    printw("╰───────────────────────────────╯\n");
+    return tile_len;
+}
 
-    // draw the grid and contents
-    for (size_t i = 0; i <= dim; i++) {
-        // draw one horizontal border line
-        for (size_t j = 0; j <= dim; j++) {
-            // choose corner/junction glyph
-            char *glyph = NULL;
-            if (i == 0 && j == 0) {
-                glyph = "╭";
+// choose corner/junction glyph. sides where the viewport cuts the board are
+// drawn as junctions, so a partial board reads as continuing past the edge
+static const char *border_glyph(bool top, bool bottom, bool left,
+                                bool right) {
+    if (top && left) {
+        return "╭";
+    }
+    if (top && right) {
+        return "╮";
+    }
+    if (bottom && left) {
+        return "╰";
+    }
+    if (bottom && right) {
+        return "╯";
+    }
+    if (top) {
+        return "┬";
+    }
+    if (bottom) {
+        return "┴";
+    }
+    if (left) {
+        return "├";
+    }
+    if (right) {
+        return "┤";
+    }
+    return "┼";
+}
 
-            } else if (i == 0 && j == dim) {
-                glyph = "╮";
+// draw the score header and the part of the grid that fits into the
+// height x width area of win at (y, x), or up to the window edge if that is
+// closer. every line is composed into one buffer and written to an off-screen
+// pad with a single call, tile colours are laid over it afterwards and the
+// pad is then copied into win. vp is clamped so it never scrolls past the
+// board. returns the number of lines drawn
+int GameState_print_window(WINDOW *win, int y, int x, int height, int width,
+                           const GameState *gs, Viewport *vp) {
+    if (!gs) {
+        mvwprintw(win, y, x, "Game state is NULL");
+        return 1;
+    }
 
-            } else if (i == dim && j == 0) {
-                glyph = "╰";
+    ensure_colors_initialized();
 
-            } else if (i == dim && j == dim) {
-                glyph = "╯";
+    int max_h = 0;
+    int max_w = 0;
+    getmaxyx(win, max_h, max_w);
+    int avail_h = max_h - y < height ? max_h - y : height;
+    int avail_w = max_w - x < width ? max_w - x : width;
 
-            } else if (i == 0) {
-                glyph = "┬";
+    const size_t dim = gs->dim;
+    const int cell_w = cell_width(vp->compact);
+    const int cell_h = cell_height(vp->compact);
 
-            } else if (i == dim) {
-                glyph = "┴";
+    // how many tiles fit, leaving a line for the position if they do not all
+    int grid_h = avail_h - HEADER_HEIGHT - 1;
+    size_t rows_fit = grid_h > 0 ? (size_t)(grid_h / (cell_h + 1)) : 0;
+    size_t cols_fit = avail_w > 1 ? (size_t)((avail_w - 1) / (cell_w + 1)) : 0;
+    bool clipped = rows_fit < dim || cols_fit < dim;
+    if (clipped && grid_h > 0) {
+        rows_fit = (size_t)((grid_h - 1) / (cell_h + 1));
+    }
+    size_t rows = rows_fit < dim ? rows_fit : dim;
+    size_t cols = cols_fit < dim ? cols_fit : dim;
+    if (rows == 0) {
+        rows = 1;
+    }
+    if (cols == 0) {
+        cols = 1;
+    }
 
-            } else if (j == 0) {
-                glyph = "├";
+    if (vp->row > dim - rows) {
+        vp->row = dim - rows;
+    }
+    if (vp->col > dim - cols) {
+        vp->col = dim - cols;
+    }
 
-            } else if (j == dim) {
-                glyph = "┤";
+    int pad_h = HEADER_HEIGHT + ((int)rows * (cell_h + 1)) + 1;
+    if (clipped) {
+        pad_h++;
+    }
+    int pad_w = ((int)cols * (cell_w + 1)) + 1;
+    if (pad_w < HEADER_WIDTH) {
+        pad_w = HEADER_WIDTH;
+    }
 
-            } else {
-                glyph = "┼";
-            }
+    WINDOW *pad = get_render_pad(pad_h, pad_w);
+    // box drawing glyphs take up to 3 bytes
+    char *buf = get_render_line(((size_t)pad_w * 3) + TILE_STRING_BUF_SIZE);
+    if (!pad || !buf) {
+        mvwprintw(win, y, x, "Out of memory");
+        return 1;
+    }
+
+    int line = 0;
+    mvwaddstr(pad, line++, 0, "╭───────────────────────────────╮");
+    if (gs->prev_left != 0) {
+        snprintf(buf, render_line_size, "│ Score: %-10u  Undos: %-3zu │",
+                 gs->score, gs->prev_left);
+    } else {
+        snprintf(buf, render_line_size, "│ Score: %-10u             │",
+                 gs->score);
+    }
+    mvwaddstr(pad, line++, 0, buf);
+    mvwaddstr(pad, line++, 0, "╰───────────────────────────────╯");
+
+    bool at_top = vp->row == 0;
+    bool at_bottom = vp->row + rows == dim;
+    bool at_left = vp->col == 0;
+    bool at_right = vp->col + cols == dim;
 
-            printw("%s", glyph);
-            if (j < dim) {
+    // draw the grid and contents
+    for (size_t i = 0; i <= rows; i++) {
+        // draw one horizontal border line
+        size_t len = 0;
+        buf[0] = '\0';
+        for (size_t j = 0; j <= cols; j++) {
+            len = append(
+                buf, len,
+                border_glyph(i == 0 && at_top, i == rows && at_bottom,
+                             j == 0 && at_left, j == cols && at_right));
+            if (j < cols) {
                 for (int k = 0; k < cell_w; k++) {
-                    printw("─");
+                    len = append(buf, len, "─");
                 }
             }
         }
-        printw("\n");
-
-        // draw the cell_h content-rows for each row of tiles
-        if (i < dim) {
-            for (size_t row = 0; row < cell_h; row++) {
-                for (size_t j = 0; j < dim; j++) {
-                    printw("│");
-                    uint32_t val = GameState_get(gs, i, j);
-
-                    // center on the middle content row
-                    if (row == cell_h / 2 && val != 0) {
-                        char buf[TILE_STRING_BUF_SIZE];
-                        snprintf(buf, sizeof(buf), "%u", val);
-                        uint8_t len = strlen(buf);
-                        uint8_t padL = (cell_w - len) / 2;
-                        uint8_t padR = cell_w - len - padL;
-
-                        int pair = pair_for_value(val);
-                        if (pair != 0) {
-                            if (pair <= LIGHT_THRES) {
-                                attron(COLOR_PAIR(pair) | A_REVERSE);
-                            } else {
-                                attron(COLOR_PAIR(pair));
-                            }
-                        }
-
-                        printw("%*s%s%*s", padL, "", buf, padR, "");
-
-                        if (pair != 0) {
-                            if (pair <= LIGHT_THRES) {
-                                attroff(COLOR_PAIR(pair) | A_REVERSE);
-                            } else {
-                                attroff(COLOR_PAIR(pair));
-                            }
-                        }
-                    } else {
-                        // blank or full-background line
-                        uint8_t pair = pair_for_value(val);
-                        if (pair != 0) {
-                            if (pair <= LIGHT_THRES) {
-                                attron(COLOR_PAIR(pair) | A_REVERSE);
-                            } else {
-                                attron(COLOR_PAIR(pair));
-                            }
-                        }
-
-                        printw("%*s", cell_w, "");
-
-                        if (pair != 0) {
-                            if (pair <= LIGHT_THRES) {
-                                attroff(COLOR_PAIR(pair) | A_REVERSE);
-                            } else {
-                                attroff(COLOR_PAIR(pair));
-                            }
-                        }
-                    }
+        mvwaddstr(pad, line++, 0, buf);
+
+        if (i == rows) {
+            break;
+        }
+
+        // draw the cell_h content-rows for each row of tiles, centering the
+        // value on the middle one
+        for (int row = 0; row < cell_h; row++) {
+            len = 0;
+            for (size_t j = 0; j < cols; j++) {
+                len = append(buf, len, "│");
+                uint32_t val = GameState_get(gs, vp->row + i, vp->col + j);
+                if (row == cell_h / 2 && val != 0) {
+                    char tile[TILE_STRING_BUF_SIZE];
+                    int tile_len = tile_label(tile, sizeof(tile), val, cell_w);
+                    int padL = (cell_w - tile_len) / 2;
+                    int padR = cell_w - tile_len - padL;
+                    len += sprintf(buf + len, "%*s%.*s%*s", padL, "", tile_len,
+                                   tile, padR, "");
+                } else {
+                    // blank or full-background line
+                    len += sprintf(buf + len, "%*s", cell_w, "");
                 }
-                printw("│\n");
             }
+            append(buf, len, "│");
+            mvwaddstr(pad, line, 0, buf);
+
+            for (size_t j = 0; j < cols; j++) {
+                uint8_t pair = pair_for_value(
+                    GameState_get(gs, vp->row + i, vp->col + j));
+                if (pair != 0) {
+                    attr_t attr = pair <= LIGHT_THRES ? A_REVERSE : A_NORMAL;
+                    mvwchgat(pad, line, 1 + ((int)j * (cell_w + 1)), cell_w,
+                             attr, pair, NULL);
+                }
+            }
+            line++;
         }
     }
+
+    if (clipped) {
+        snprintf(buf, render_line_size, "rows %zu-%zu/%zu  cols %zu-%zu/%zu",
+                 vp->row + 1, vp->row + rows, dim, vp->col + 1,
+                 vp->col + cols, dim);
+        mvwaddstr(pad, line++, 0, buf);
+    }
+
+    // copy only what fits into win
+    int copy_h = line < avail_h ? line : avail_h;
+    int copy_w = pad_w < avail_w ? pad_w : avail_w;
+    if (copy_h > 0 && copy_w > 0) {
+        copywin(pad, win, 0, 0, y, x, y + copy_h - 1, x + copy_w - 1, FALSE);
+    }
+    return line;
+}
+
+// draw gs on stdscr below the cursor, leaving the cursor on the next line
+void GameState_print(GameState *gs) {
+    int y = 0;
+    int x = 0;
+    getyx(stdscr, y, x);
+    (void)x;
+
+    // keep the blank line above the board, and room for the game over
+    // message below it. the help box only shows if there is space left
+    y++;
+    int height = GameState_print_window(stdscr, y, 0, LINES - y - STATUS_HEIGHT,
+                                        COLS, gs, &screen_viewport);
+    move(y + height, 0);
 }
 
 #endif // RENDER_C
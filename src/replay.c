@@ -0,0 +1,349 @@
+#ifndef REPLAY_C
+#define REPLAY_C
+
+#include "game_state.c"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// replay files are plain text: a header line, then one record per line.
+//   2048-tui-replay <version> <dim>
+//   b <score> <tile> ... <tile>     full board (start of game, after undos)
+//   m <l|r|u|d> [<index> <value>]   move, with the tile spawned after it
+#define REPLAY_MAGIC "2048-tui-replay"
+#define REPLAY_VERSION 1
+#define REPLAY_NO_SPAWN SIZE_MAX
+
+// seek cost is bounded by this many moves, unless keeping a board every
+// REPLAY_KEYFRAME_INTERVAL moves would exceed REPLAY_KEYFRAME_BUDGET bytes
+#define REPLAY_KEYFRAME_INTERVAL 64
+#define REPLAY_KEYFRAME_BUDGET ((size_t)64 * 1024 * 1024)
+
+static const char replay_dir_chars[] = {
+    [DIRECTION_LEFT] = 'l',
+    [DIRECTION_RIGHT] = 'r',
+    [DIRECTION_UP] = 'u',
+    [DIRECTION_DOWN] = 'd',
+};
+
+typedef struct {
+    bool is_board;
+    Direction dir;
+    size_t spawn;
+    uint32_t value;
+    size_t board; // index into Replay.boards for board records
+} ReplayStep;
+
+typedef struct {
+    size_t dim;
+    ReplayStep *steps;
+    size_t length;
+    size_t capacity;
+    // boards from 'b' records, dim * dim tiles each
+    uint32_t *boards;
+    uint32_t *board_scores;
+    size_t boards_length;
+    size_t boards_capacity;
+    // state after every interval-th step, built once at load
+    size_t interval;
+    uint32_t *keyframes;
+    uint32_t *keyframe_scores;
+} Replay;
+
+// -- recording --
+
+static void Replay_write_board(FILE *out, const GameState *gs) {
+    fprintf(out, "b %u", gs->score);
+    for (size_t i = 0; i < gs->tiles.length; ++i) {
+        fprintf(out, " %u", gs->tiles.items[i]);
+    }
+    fputc('\n', out);
+}
+
+FILE *Replay_record_open(const char *path, const GameState *gs) {
+    FILE *out = fopen(path, "w");
+    if (!out) {
+        return NULL;
+    }
+    fprintf(out, "%s %d %zu\n", REPLAY_MAGIC, REPLAY_VERSION, gs->dim);
+    Replay_write_board(out, gs);
+    return out;
+}
+
+// record the state reached by an undo (or any other jump) as a full board
+void Replay_record_board(FILE *out, const GameState *gs) {
+    if (out) {
+        Replay_write_board(out, gs);
+    }
+}
+
+// record a move; spawn is REPLAY_NO_SPAWN if no tile spawned after it
+void Replay_record_move(FILE *out, Direction dir, const GameState *gs,
+                        size_t spawn) {
+    if (!out) {
+        return;
+    }
+    if (spawn == REPLAY_NO_SPAWN) {
+        fprintf(out, "m %c\n", replay_dir_chars[dir]);
+    } else {
+        fprintf(out, "m %c %zu %u\n", replay_dir_chars[dir], spawn,
+                gs->tiles.items[spawn]);
+    }
+}
+
+// -- loading --
+
+void Replay_destroy(Replay *replay) {
+    if (replay) {
+        free(replay->steps);
+        free(replay->boards);
+        free(replay->board_scores);
+        free(replay->keyframes);
+        free(replay->keyframe_scores);
+        free(replay);
+    }
+}
+
+static bool Replay_push_step(Replay *replay, ReplayStep step) {
+    if (replay->length == replay->capacity) {
+        size_t capacity = replay->capacity ? replay->capacity * 2 : 256;
+        ReplayStep *steps =
+            realloc(replay->steps, capacity * sizeof(ReplayStep));
+        if (!steps) {
+            return false;
+        }
+        replay->steps = steps;
+        replay->capacity = capacity;
+    }
+    replay->steps[replay->length++] = step;
+    return true;
+}
+
+static bool Replay_read_board(Replay *replay, FILE *in) {
+    size_t size = replay->dim * replay->dim;
+    if (replay->boards_length == replay->boards_capacity) {
+        size_t capacity =
+            replay->boards_capacity ? replay->boards_capacity * 2 : 4;
+        if (capacity > SIZE_MAX / sizeof(uint32_t) / size) {
+            return false;
+        }
+        uint32_t *boards =
+            realloc(replay->boards, capacity * size * sizeof(uint32_t));
+        if (!boards) {
+            return false;
+        }
+        replay->boards = boards;
+        uint32_t *scores =
+            realloc(replay->board_scores, capacity * sizeof(uint32_t));
+        if (!scores) {
+            return false;
+        }
+        replay->board_scores = scores;
+        replay->boards_capacity = capacity;
+    }
+
+    size_t board = replay->boards_length;
+    uint32_t *tiles = replay->boards + (board * size);
+    if (fscanf(in, "%u", &replay->board_scores[board]) != 1) {
+        return false;
+    }
+    for (size_t i = 0; i < size; ++i) {
+        if (fscanf(in, "%u", &tiles[i]) != 1) {
+            return false;
+        }
+    }
+    replay->boards_length++;
+
+    return Replay_push_step(replay,
+                            (ReplayStep){.is_board = true, .board = board});
+}
+
+static bool Replay_read_move(Replay *replay, FILE *in) {
+    char dir_char = 0;
+    if (fscanf(in, " %c", &dir_char) != 1) {
+        return false;
+    }
+
+    ReplayStep step = {.is_board = false, .spawn = REPLAY_NO_SPAWN};
+    const char *found = memchr(replay_dir_chars, dir_char,
+                               sizeof(replay_dir_chars));
+    if (!found) {
+        return false;
+    }
+    step.dir = (Direction)(found - replay_dir_chars);
+
+    // the spawn is optional, so only consume it if it is on this line
+    int c = fgetc(in);
+    while (c == ' ') {
+        c = fgetc(in);
+    }
+    if (c != '\n' && c != EOF) {
+        ungetc(c, in);
+        // the game only ever spawns a 2 or a 4
+        if (fscanf(in, "%zu %u", &step.spawn, &step.value) != 2 ||
+            step.spawn >= replay->dim * replay->dim ||
+            (step.value != 2 && step.value != 4)) {
+            return false;
+        }
+    }
+    return Replay_push_step(replay, step);
+}
+
+static void Replay_load_tiles(GameState *gs, const uint32_t *tiles,
+                              uint32_t score) {
+    memcpy(gs->tiles.items, tiles, gs->tiles.length * sizeof(uint32_t));
+    GameState_sync_occupancy(gs);
+    gs->score = score;
+}
+
+// advance gs by one step of the replay. returns the (possibly reallocated)
+// state, or NULL if the step is not a legal move from gs or spawns onto a
+// tile. gs is consumed either way
+static GameState *Replay_apply(const Replay *replay, GameState *gs,
+                               size_t index) {
+    const ReplayStep *step = &replay->steps[index];
+    if (step->is_board) {
+        size_t size = replay->dim * replay->dim;
+        Replay_load_tiles(gs, replay->boards + (step->board * size),
+                          replay->board_scores[step->board]);
+        return gs;
+    }
+
+    GameState *next = GameState_slide_and_merge(gs, step->dir);
+    if (!next) {
+        GameState_destroy_chain(gs);
+        return NULL;
+    }
+    if (step->spawn != REPLAY_NO_SPAWN) {
+        size_t i = step->spawn / replay->dim;
+        size_t j = step->spawn % replay->dim;
+        if (GameState_get(next, i, j) != 0) {
+            GameState_destroy_chain(next);
+            return NULL;
+        }
+        GameState_set(next, i, j, step->value);
+    }
+    return next;
+}
+
+static void Replay_store_keyframe(Replay *replay, size_t keyframe,
+                                  const GameState *gs) {
+    size_t size = replay->dim * replay->dim;
+    memcpy(replay->keyframes + (keyframe * size), gs->tiles.items,
+           size * sizeof(uint32_t));
+    replay->keyframe_scores[keyframe] = gs->score;
+}
+
+// replay the whole game once, keeping every interval-th state
+static bool Replay_build_index(Replay *replay) {
+    size_t size = replay->dim * replay->dim;
+    size_t board_bytes = size * sizeof(uint32_t);
+
+    replay->interval = REPLAY_KEYFRAME_INTERVAL;
+    size_t budget_boards = REPLAY_KEYFRAME_BUDGET / board_bytes;
+    size_t budget_interval =
+        budget_boards > 0 ? (replay->length / budget_boards) + 1
+                          : replay->length;
+    if (budget_interval > replay->interval) {
+        replay->interval = budget_interval;
+    }
+
+    size_t keyframes = ((replay->length - 1) / replay->interval) + 1;
+    if (keyframes > SIZE_MAX / board_bytes) {
+        return false;
+    }
+    replay->keyframes = malloc(keyframes * board_bytes);
+    replay->keyframe_scores = malloc(keyframes * sizeof(uint32_t));
+    GameState *gs = GameState_create(replay->dim, 0);
+    if (!replay->keyframes || !replay->keyframe_scores || !gs) {
+        GameState_destroy_chain(gs);
+        return false;
+    }
+
+    for (size_t i = 0; i < replay->length; ++i) {
+        gs = Replay_apply(replay, gs, i);
+        if (!gs) {
+            return false;
+        }
+        if (i % replay->interval == 0) {
+            Replay_store_keyframe(replay, i / replay->interval, gs);
+        }
+    }
+
+    GameState_destroy_chain(gs);
+    return true;
+}
+
+Replay *Replay_load(const char *path) {
+    FILE *in = fopen(path, "r");
+    if (!in) {
+        return NULL;
+    }
+
+    Replay *replay = calloc(1, sizeof(Replay));
+    if (!replay) {
+        fclose(in);
+        return NULL;
+    }
+
+    char magic[sizeof(REPLAY_MAGIC)] = {0};
+    int version = 0;
+    bool ok = fscanf(in, "%15s %d %zu", magic, &version, &replay->dim) == 3 &&
+              strcmp(magic, REPLAY_MAGIC) == 0 &&
+              version == REPLAY_VERSION && replay->dim >= 3 &&
+              replay->dim <= SIZE_MAX / replay->dim &&
+              replay->dim * replay->dim <= SIZE_MAX / sizeof(uint32_t);
+
+    char kind = 0;
+    while (ok && fscanf(in, " %c", &kind) == 1) {
+        if (kind == 'b') {
+            ok = Replay_read_board(replay, in);
+        } else if (kind == 'm') {
+            ok = Replay_read_move(replay, in);
+        } else {
+            ok = false;
+        }
+    }
+    fclose(in);
+
+    // a replay has to start from a full board
+    ok = ok && replay->length > 0 && replay->steps[0].is_board &&
+         Replay_build_index(replay);
+    if (!ok) {
+        Replay_destroy(replay);
+        return NULL;
+    }
+    return replay;
+}
+
+// number of positions in the replay, the starting board included
+size_t Replay_length(const Replay *replay) { return replay->length; }
+
+// state of the game after step index, reached from the nearest keyframe
+// before it. gs must have been created with the replay's dimension
+GameState *Replay_seek(const Replay *replay, GameState *gs, size_t index) {
+    if (index >= replay->length) {
+        index = replay->length - 1;
+    }
+
+    size_t keyframe = index / replay->interval;
+    size_t size = replay->dim * replay->dim;
+    Replay_load_tiles(gs, replay->keyframes + (keyframe * size),
+                      replay->keyframe_scores[keyframe]);
+
+    // the index was validated at load, so these moves always apply
+    for (size_t i = (keyframe * replay->interval) + 1; i <= index; ++i) {
+        gs = Replay_apply(replay, gs, i);
+    }
+    return gs;
+}
+
+// step gs, currently at position index - 1, forward to position index
+GameState *Replay_step(const Replay *replay, GameState *gs, size_t index) {
+    return Replay_apply(replay, gs, index);
+}
+
+#endif // REPLAY_C
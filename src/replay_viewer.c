@@ -0,0 +1,163 @@
+#ifndef REPLAY_VIEWER_C
+#define REPLAY_VIEWER_C
+
+#include "game_state.c"
+#include "render.c"
+#include "replay.c"
+#include <ncurses.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define REPLAY_DEFAULT_SPEED 8
+#define REPLAY_MAX_SPEED 1024
+#define REPLAY_JUMP_BUF_SIZE 24
+#define REPLAY_JUMP_BASE 10
+#define REPLAY_STATUS_BUF_SIZE 32
+#define MS_PER_SECOND 1000
+
+static void Replay_draw(const Replay *replay, GameState *gs, size_t position,
+                        int32_t speed, bool playing) {
+    clear();
+    GameState_print(gs);
+
+    char status[REPLAY_STATUS_BUF_SIZE];
+    printw("╭╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╮\n");
+    snprintf(status, sizeof(status), "Move %zu/%zu", position,
+             Replay_length(replay) - 1);
+    printw("╎ %-29s ╎\n", status);
+    snprintf(status, sizeof(status), "%s at %d moves/s",
+             playing ? "Playing" : "Paused", speed);
+    printw("╎ %-29s ╎\n", status);
+    printw("╰╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╯\n");
+
+    printw("╭╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╮\n");
+    printw("╎ Step with:   h l,   ← →.      ╎\n");
+    printw("╎ Play/pause:  space.           ╎\n");
+    printw("╎ Speed:       + -.             ╎\n");
+    printw("╎ Jump with:   g, 0, $.         ╎\n");
+    printw("╎ Pan/zoom:    H J K L, c.      ╎\n");
+    printw("╰╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╌╯\n");
+    refresh();
+}
+
+// ask for a move number on the bottom line, returns false if cancelled
+static bool Replay_prompt_position(size_t *position) {
+    char buf[REPLAY_JUMP_BUF_SIZE] = {0};
+
+    printw("Jump to move: ");
+    echo();
+    timeout(-1);
+    int status = getnstr(buf, sizeof(buf) - 1);
+    noecho();
+
+    char *end = NULL;
+    unsigned long long value = strtoull(buf, &end, REPLAY_JUMP_BASE);
+    if (status == ERR || end == buf || *end != '\0') {
+        return false;
+    }
+    *position = value;
+    return true;
+}
+
+// interactive viewer for a loaded replay. ncurses must be initialized
+void Replay_watch(const Replay *replay) {
+    GameState *gs = GameState_create(replay->dim, 0);
+    if (!gs) {
+        return;
+    }
+
+    size_t last = Replay_length(replay) - 1;
+    size_t position = 0;
+    int32_t speed = REPLAY_DEFAULT_SPEED;
+    bool playing = false;
+    gs = Replay_seek(replay, gs, position);
+
+    int32_t ch = 0;
+    do {
+        size_t target = position;
+        switch (ch) {
+        case KEY_RIGHT:
+        case 'l':
+        case ERR: // playback timer
+            if (target < last) {
+                target++;
+            }
+            break;
+        case KEY_LEFT:
+        case 'h':
+            if (target > 0) {
+                target--;
+            }
+            break;
+        case '0':
+        case KEY_HOME:
+            target = 0;
+            break;
+        case '$':
+        case KEY_END:
+            target = last;
+            break;
+        case 'g':
+            if (Replay_prompt_position(&target) && target > last) {
+                target = last;
+            }
+            break;
+        case ' ':
+            playing = !playing;
+            break;
+        case '+':
+        case '=':
+            if (speed < REPLAY_MAX_SPEED) {
+                speed *= 2;
+            }
+            break;
+        case '-':
+            if (speed > 1) {
+                speed /= 2;
+            }
+            break;
+        case KEY_SLEFT:
+        case 'H':
+            GameState_pan(0, -1);
+            break;
+        case KEY_SF:
+        case 'J':
+            GameState_pan(1, 0);
+            break;
+        case KEY_SR:
+        case 'K':
+            GameState_pan(-1, 0);
+            break;
+        case KEY_SRIGHT:
+        case 'L':
+            GameState_pan(0, 1);
+            break;
+        case 'c':
+            GameState_toggle_compact();
+            break;
+        default:
+            break;
+        }
+
+        // stepping forward is a single move, anything else seeks from the
+        // nearest keyframe
+        if (target == position + 1) {
+            gs = Replay_step(replay, gs, target);
+        } else if (target != position) {
+            gs = Replay_seek(replay, gs, target);
+        }
+        position = target;
+
+        if (position == last) {
+            playing = false;
+        }
+
+        Replay_draw(replay, gs, position, speed, playing);
+        timeout(playing ? MS_PER_SECOND / speed : -1);
+    } while ((ch = getch()) != 'q');
+
+    GameState_destroy_chain(gs);
+}
+
+#endif // REPLAY_VIEWER_C
@@ -0,0 +1,128 @@
+#ifndef SEARCH_C
+#define SEARCH_C
+
+#include "game_state.c"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SEARCH_DEFAULT_DEPTH 2
+#define SEARCH_NR_OF_DIRECTIONS 4
+// chance nodes look at no more than this many empty tiles, spread evenly
+// over the board, so big boards stay searchable
+#define SEARCH_CHANCE_LIMIT 16
+#define SEARCH_TWO_PROBABILITY 0.9
+#define SEARCH_FOUR_PROBABILITY 0.1
+
+static const char *const direction_names[SEARCH_NR_OF_DIRECTIONS] = {
+    [DIRECTION_LEFT] = "left",
+    [DIRECTION_RIGHT] = "right",
+    [DIRECTION_UP] = "up",
+    [DIRECTION_DOWN] = "down",
+};
+
+// expected score for each first move, searched depth moves deep
+typedef struct {
+    bool legal[SEARCH_NR_OF_DIRECTIONS];
+    double value[SEARCH_NR_OF_DIRECTIONS];
+    Direction best;
+    bool can_move;
+} SearchResult;
+
+// the board after moving gs in dir without touching gs, or NULL if the move
+// does not change anything. the move is made on a single copy of gs
+static GameState *Search_child(const GameState *gs, Direction dir) {
+    GameState *child = GameState_copy(gs);
+    if (child && !GameState_slide_and_merge_in_place(child, dir)) {
+        GameState_destroy_chain(child);
+        child = NULL;
+    }
+    return child;
+}
+
+static double Search_max_node(const GameState *gs, size_t depth);
+
+// average over the tiles that could spawn on gs, then let the player move
+static double Search_chance_node(GameState *gs, size_t depth) {
+    uint32_t *items = gs->tiles.items;
+    size_t size = gs->tiles.length;
+
+    size_t empty = 0;
+    for (size_t i = 0; i < size; ++i) {
+        if (items[i] == 0) {
+            empty++;
+        }
+    }
+    if (empty == 0) {
+        return Search_max_node(gs, depth);
+    }
+
+    size_t stride = (empty + SEARCH_CHANCE_LIMIT - 1) / SEARCH_CHANCE_LIMIT;
+    double total = 0.0;
+    size_t samples = 0;
+    size_t seen = 0;
+    for (size_t i = 0; i < size; ++i) {
+        if (items[i] != 0 || seen++ % stride != 0) {
+            continue;
+        }
+
+        size_t row = i / gs->dim;
+        size_t col = i % gs->dim;
+        GameState_set(gs, row, col, 2);
+        total += SEARCH_TWO_PROBABILITY * Search_max_node(gs, depth);
+        GameState_set(gs, row, col, 4);
+        total += SEARCH_FOUR_PROBABILITY * Search_max_node(gs, depth);
+        GameState_set(gs, row, col, 0);
+        samples++;
+    }
+    return total / (double)samples;
+}
+
+static double Search_max_node(const GameState *gs, size_t depth) {
+    if (depth == 0) {
+        return gs->score;
+    }
+
+    // a lost game keeps the score it has
+    double best = gs->score;
+    bool moved = false;
+    for (size_t d = 0; d < SEARCH_NR_OF_DIRECTIONS; ++d) {
+        GameState *child = Search_child(gs, (Direction)d);
+        if (!child) {
+            continue;
+        }
+        double value = Search_chance_node(child, depth - 1);
+        if (!moved || value > best) {
+            best = value;
+        }
+        moved = true;
+        GameState_destroy_chain(child);
+    }
+    return best;
+}
+
+// expectimax over depth player moves (at least one) from gs
+SearchResult Search_evaluate(const GameState *gs, size_t depth) {
+    SearchResult result = {.best = DIRECTION_LEFT, .can_move = false};
+    if (depth == 0) {
+        depth = 1;
+    }
+
+    for (size_t d = 0; d < SEARCH_NR_OF_DIRECTIONS; ++d) {
+        GameState *child = Search_child(gs, (Direction)d);
+        if (!child) {
+            continue;
+        }
+
+        result.legal[d] = true;
+        result.value[d] = Search_chance_node(child, depth - 1);
+        if (!result.can_move || result.value[d] > result.value[result.best]) {
+            result.best = (Direction)d;
+        }
+        result.can_move = true;
+        GameState_destroy_chain(child);
+    }
+    return result;
+}
+
+#endif // SEARCH_C
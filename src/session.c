@@ -0,0 +1,396 @@
+#ifndef SESSION_C
+#define SESSION_C
+
+#include "game_state.c"
+#include "undo_journal.c"
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// session files hold the live game in a binary layout that is mapped into
+// memory. the undo journal of the game keeps its arrays in the mapping, so
+// resuming only has to check the header:
+//   SessionHeader
+//   tiles           dim * dim uint32_t, padded to SESSION_ALIGN bytes
+//   entries         capacity UndoEntry, the journal's entries
+//   cells           cells_capacity uint32_t, the journal's cell arena
+// the file grows along with the journal. all fields are in native byte order
+// and layout, files written with another one are rejected by the version,
+// byte order and size checks
+#define SESSION_MAGIC "2048ses"
+#define SESSION_MAGIC_SIZE 8
+#define SESSION_VERSION 3
+#define SESSION_BYTE_ORDER 0x01020304u
+#define SESSION_ALIGN 8
+#define SESSION_MODE 0644
+
+// the journal counters are those of the last Session_sync, entries and cells
+// past them may already hold the next move
+typedef struct {
+    char magic[SESSION_MAGIC_SIZE];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t header_size;
+    uint32_t entry_size;
+    uint64_t dim;
+    uint64_t prev_left;
+    uint64_t first;
+    uint64_t count;
+    uint64_t capacity;
+    uint64_t cells_length;
+    uint64_t cells_capacity;
+    uint32_t score;
+    uint32_t padding;
+} SessionHeader;
+
+typedef struct {
+    int fd;
+    void *map;
+    size_t size;
+    SessionHeader *header;
+    uint32_t *tiles;
+    UndoEntry *entries;
+    uint32_t *cells;
+} Session;
+
+// byte offsets of the regions of a session for dim and a journal of capacity
+// entries and cells_capacity cells, false if the file would not fit in memory
+static bool Session_layout(uint64_t dim, uint64_t capacity,
+                           uint64_t cells_capacity, size_t *entries_at,
+                           size_t *cells_at, size_t *size) {
+    if (dim == 0 || dim > SIZE_MAX / dim) {
+        return false;
+    }
+    size_t board = dim * dim;
+    if (board > SIZE_MAX / sizeof(uint32_t) / 2) {
+        return false;
+    }
+
+    size_t tiles_bytes = board * sizeof(uint32_t);
+    tiles_bytes = (tiles_bytes + SESSION_ALIGN - 1) / SESSION_ALIGN *
+                  SESSION_ALIGN;
+    *entries_at = sizeof(SessionHeader) + tiles_bytes;
+    if (capacity > (SIZE_MAX - *entries_at) / sizeof(UndoEntry)) {
+        return false;
+    }
+    *cells_at = *entries_at + (capacity * sizeof(UndoEntry));
+    if (cells_capacity > (SIZE_MAX - *cells_at) / sizeof(uint32_t)) {
+        return false;
+    }
+    *size = *cells_at + (cells_capacity * sizeof(uint32_t));
+    return true;
+}
+
+static void Session_unmap(Session *session) {
+    if (session->map != MAP_FAILED) {
+        munmap(session->map, session->size);
+    }
+    session->map = MAP_FAILED;
+    session->size = 0;
+    session->header = NULL;
+}
+
+// map the first size bytes of the file, the old mapping is kept if that fails
+static bool Session_map(Session *session, size_t size) {
+    void *map =
+        mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, session->fd, 0);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    Session_unmap(session);
+    session->map = map;
+    session->size = size;
+    session->header = session->map;
+    return true;
+}
+
+// point the region pointers at the mapping, false if the mapped header
+// describes a session larger than the mapping. a larger file is left over
+// from a journal that failed to grow and the excess is ignored
+static bool Session_locate(Session *session) {
+    const SessionHeader *header = session->header;
+    size_t entries_at = 0;
+    size_t cells_at = 0;
+    size_t size = 0;
+    if (!Session_layout(header->dim, header->capacity, header->cells_capacity,
+                        &entries_at, &cells_at, &size) ||
+        size > session->size) {
+        return false;
+    }
+
+    char *base = session->map;
+    session->tiles = (uint32_t *)(base + sizeof(SessionHeader));
+    session->entries = (UndoEntry *)(base + entries_at);
+    session->cells = (uint32_t *)(base + cells_at);
+    return true;
+}
+
+// UndoJournal_grow_fn for a journal kept in the session. the file grows to
+// the new layout and the cells move up behind the larger entries region,
+// with the header following along
+static bool Session_grow(void *ctx, UndoJournal *journal, size_t capacity,
+                         size_t cells_capacity) {
+    Session *session = ctx;
+    size_t entries_at = 0;
+    size_t cells_at = 0;
+    size_t size = 0;
+    if (!Session_layout(session->header->dim, capacity, cells_capacity,
+                        &entries_at, &cells_at, &size)) {
+        return false;
+    }
+
+    // a hangup halfway through moving the cells would lose them
+    sigset_t all;
+    sigset_t old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &old);
+
+    size_t old_cells_at = (char *)session->cells - (char *)session->map;
+    bool grown = ftruncate(session->fd, (off_t)size) == 0 &&
+                 Session_map(session, size);
+    if (grown) {
+        SessionHeader *header = session->header;
+        char *base = session->map;
+        memmove(base + cells_at, base + old_cells_at,
+                header->cells_capacity * sizeof(uint32_t));
+        header->capacity = capacity;
+        header->cells_capacity = cells_capacity;
+        grown = Session_locate(session);
+    }
+    if (grown) {
+        journal->entries = session->entries;
+        journal->capacity = capacity;
+        journal->cells = session->cells;
+        journal->cells_capacity = cells_capacity;
+    }
+
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    return grown;
+}
+
+// move the journal of gs, empty or saved in the session, into the mapping
+static void Session_attach(Session *session, GameState *gs) {
+    if (!gs->journal) {
+        return;
+    }
+    const SessionHeader *header = session->header;
+    UndoJournal saved = {
+        .entries = session->entries,
+        .first = header->first,
+        .count = header->count,
+        .capacity = header->capacity,
+        .cells = session->cells,
+        .cells_length = header->cells_length,
+        .cells_capacity = header->cells_capacity,
+    };
+    UndoJournal_attach(gs->journal, &saved, Session_grow, session);
+}
+
+// replace whatever the file held with gs, which has no history yet
+static bool Session_start(Session *session, GameState *gs) {
+    size_t entries_at = 0;
+    size_t cells_at = 0;
+    size_t size = 0;
+    if (!Session_layout(gs->dim, 0, 0, &entries_at, &cells_at, &size)) {
+        return false;
+    }
+
+    Session_unmap(session);
+    if (ftruncate(session->fd, 0) != 0 ||
+        ftruncate(session->fd, (off_t)size) != 0 ||
+        !Session_map(session, size)) {
+        return false;
+    }
+
+    SessionHeader *header = session->header;
+    *header = (SessionHeader){
+        .version = SESSION_VERSION,
+        .byte_order = SESSION_BYTE_ORDER,
+        .header_size = sizeof(SessionHeader),
+        .entry_size = sizeof(UndoEntry),
+        .dim = gs->dim,
+        .prev_left = gs->prev_left,
+        .first = 0,
+        .count = 0,
+        .capacity = 0,
+        .cells_length = 0,
+        .cells_capacity = 0,
+        .score = gs->score,
+    };
+    memcpy(header->magic, SESSION_MAGIC, SESSION_MAGIC_SIZE);
+    if (!Session_locate(session)) {
+        return false;
+    }
+    memcpy(session->tiles, gs->tiles.items,
+           gs->tiles.length * sizeof(uint32_t));
+    Session_attach(session, gs);
+    return true;
+}
+
+// the game saved in the mapped file, or NULL if it is not a valid session.
+// only the header is checked and the board copied out, the history stays in
+// the mapping. its entries are checked as they are undone
+static GameState *Session_resume(Session *session) {
+    const SessionHeader *header = session->header;
+    if (session->size < sizeof(SessionHeader) ||
+        memcmp(header->magic, SESSION_MAGIC, SESSION_MAGIC_SIZE) != 0 ||
+        header->version != SESSION_VERSION ||
+        header->byte_order != SESSION_BYTE_ORDER ||
+        header->header_size != sizeof(SessionHeader) ||
+        header->entry_size != sizeof(UndoEntry) || !Session_locate(session) ||
+        header->count > header->capacity || header->first > header->count ||
+        header->count - header->first > header->prev_left ||
+        header->cells_length > header->cells_capacity ||
+        (header->count > header->first &&
+         session->entries[header->first].offset > header->cells_length)) {
+        return NULL;
+    }
+
+    GameState *gs = GameState_create_empty(header->dim, header->prev_left);
+    if (!gs) {
+        return NULL;
+    }
+    memcpy(gs->tiles.items, session->tiles,
+           gs->tiles.length * sizeof(uint32_t));
+    GameState_sync_occupancy(gs);
+    gs->score = header->score;
+    Session_attach(session, gs);
+    return gs;
+}
+
+void Session_close(Session *session) {
+    if (!session) {
+        return;
+    }
+    if (session->map != MAP_FAILED) {
+        msync(session->map, session->size, MS_SYNC);
+    }
+    Session_unmap(session);
+    if (session->fd >= 0) {
+        close(session->fd);
+    }
+    free(session);
+}
+
+// open the session at path, creating it if needed. a game saved there is
+// resumed into *gs; if there is none, or it is over for good, a new game of
+// dim with undos is started and saved instead. *gs keeps its history in the
+// session, so it must not be used once the session is closed
+Session *Session_open(const char *path, size_t dim, size_t undos,
+                      GameState **gs) {
+    Session *session = malloc(sizeof(Session));
+    if (!session) {
+        return NULL;
+    }
+    *session = (Session){
+        .fd = open(path, O_RDWR | O_CREAT, SESSION_MODE),
+        .map = MAP_FAILED,
+    };
+
+    struct stat st;
+    if (session->fd < 0 || fstat(session->fd, &st) != 0) {
+        Session_close(session);
+        return NULL;
+    }
+
+    GameState *resumed = NULL;
+    if (st.st_size > 0) {
+        // never overwrite a file that is not a session
+        if (!Session_map(session, (size_t)st.st_size) ||
+            !(resumed = Session_resume(session))) {
+            Session_close(session);
+            return NULL;
+        }
+        if (!GameState_can_move(resumed) && resumed->prev_left == 0) {
+            GameState_destroy_chain(resumed);
+            resumed = NULL;
+        }
+    }
+
+    if (!resumed) {
+        resumed = GameState_create(dim, undos);
+        if (!resumed || !Session_start(session, resumed)) {
+            GameState_destroy_chain(resumed);
+            Session_close(session);
+            return NULL;
+        }
+    }
+
+    *gs = resumed;
+    return session;
+}
+
+// copy the cells of gs an entry names, the whole board for a keyframe, into
+// the mapped board
+static void Session_copy_cells(Session *session, const GameState *gs,
+                               const UndoEntry *entry, const uint32_t *cells) {
+    const uint32_t *items = gs->tiles.items;
+    size_t board = gs->tiles.length;
+    if (entry->keyframe) {
+        memcpy(session->tiles, items, board * sizeof(uint32_t));
+        return;
+    }
+    for (size_t k = 0; k < entry->length; k += 2) {
+        if (cells[k] < board) {
+            session->tiles[cells[k]] = items[cells[k]];
+        }
+    }
+    if (entry->spawn < board) {
+        session->tiles[entry->spawn] = items[entry->spawn];
+    }
+}
+
+// bring the session up to date with gs after a move, once its tile has
+// spawned, or after an undo. the history is already in the mapping, only the
+// cells that changed and the header are written and the file is left for
+// the kernel to write back
+void Session_sync(Session *session, const GameState *gs) {
+    if (!session || !gs) {
+        return;
+    }
+
+    // a hangup halfway through would leave board and history out of step
+    sigset_t all;
+    sigset_t old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &old);
+
+    SessionHeader *header = session->header;
+    UndoJournal *journal = gs->journal;
+    if (gs->prev_left < header->prev_left && header->count > header->first) {
+        // undoing only moves the counters, so the undone move is still the
+        // newest entry as of the last sync
+        const UndoEntry *undone = &session->entries[header->count - 1];
+        Session_copy_cells(session, gs, undone,
+                           session->cells + undone->offset);
+    } else if (gs->prev_left == header->prev_left &&
+               UndoJournal_top(journal)) {
+        const UndoEntry *top = UndoJournal_top(journal);
+        Session_copy_cells(session, gs, top, journal->cells + top->offset);
+    } else {
+        // no history to tell what changed
+        memcpy(session->tiles, gs->tiles.items,
+               gs->tiles.length * sizeof(uint32_t));
+    }
+
+    // the journal leaves compacting to the owner of its arrays, it moves
+    // entries the header still points at
+    UndoJournal_compact(journal);
+    header->first = journal ? journal->first : 0;
+    header->count = journal ? journal->count : 0;
+    header->cells_length = journal ? journal->cells_length : 0;
+    header->score = gs->score;
+    header->prev_left = gs->prev_left;
+
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+}
+
+#endif // SESSION_C
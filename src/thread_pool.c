@@ -0,0 +1,210 @@
+#ifndef THREAD_POOL_C
+#define THREAD_POOL_C
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define THREAD_POOL_MAX_THREADS 64
+
+// task callback, gets the half-open range [begin, end) and the slot index of
+// the thread running it (0 is always the calling thread)
+typedef void (*ThreadPool_fn)(void *ctx, size_t begin, size_t end,
+                              size_t slot);
+
+typedef struct ThreadPool ThreadPool;
+struct ThreadPool {
+    pthread_t *threads;
+    size_t size; // worker threads plus the calling thread
+    pthread_mutex_t dispatch;
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;
+    pthread_cond_t work_done;
+    ThreadPool_fn fn;
+    void *ctx;
+    size_t n;
+    size_t generation;
+    size_t pending;
+    bool shutdown;
+};
+
+typedef struct {
+    ThreadPool *pool;
+    size_t slot;
+} ThreadPool_worker_arg;
+
+static size_t ThreadPool_chunk_begin(size_t n, size_t size, size_t slot) {
+    return (n * slot) / size;
+}
+
+static void *ThreadPool_worker(void *arg) {
+    ThreadPool_worker_arg *worker = arg;
+    ThreadPool *pool = worker->pool;
+    size_t slot = worker->slot;
+    free(worker);
+
+    size_t seen = 0;
+    pthread_mutex_lock(&pool->lock);
+    while (true) {
+        while (!pool->shutdown && pool->generation == seen) {
+            pthread_cond_wait(&pool->work_ready, &pool->lock);
+        }
+        if (pool->shutdown) {
+            break;
+        }
+        seen = pool->generation;
+        ThreadPool_fn fn = pool->fn;
+        void *ctx = pool->ctx;
+        size_t n = pool->n;
+        pthread_mutex_unlock(&pool->lock);
+
+        size_t begin = ThreadPool_chunk_begin(n, pool->size, slot);
+        size_t end = ThreadPool_chunk_begin(n, pool->size, slot + 1);
+        if (begin < end) {
+            fn(ctx, begin, end, slot);
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->pending == 0) {
+            pthread_cond_signal(&pool->work_done);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+void ThreadPool_destroy(ThreadPool *pool) {
+    if (!pool) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = true;
+    pthread_cond_broadcast(&pool->work_ready);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (size_t i = 1; i < pool->size; ++i) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    pthread_cond_destroy(&pool->work_done);
+    pthread_cond_destroy(&pool->work_ready);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_mutex_destroy(&pool->dispatch);
+    free(pool->threads);
+    free(pool);
+}
+
+ThreadPool *ThreadPool_create(size_t size) {
+    if (size == 0) {
+        size = 1;
+    }
+    if (size > THREAD_POOL_MAX_THREADS) {
+        size = THREAD_POOL_MAX_THREADS;
+    }
+
+    ThreadPool *pool = malloc(sizeof(ThreadPool));
+    if (!pool) {
+        return NULL;
+    }
+
+    pthread_t *threads = calloc(size, sizeof(pthread_t));
+    if (!threads) {
+        free(pool);
+        return NULL;
+    }
+
+    *pool = (ThreadPool){
+        .threads = threads,
+        .size = 1,
+        .fn = NULL,
+        .ctx = NULL,
+        .n = 0,
+        .generation = 0,
+        .pending = 0,
+        .shutdown = false,
+    };
+    pthread_mutex_init(&pool->dispatch, NULL);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_ready, NULL);
+    pthread_cond_init(&pool->work_done, NULL);
+
+    // slot 0 is the calling thread, so only size - 1 workers are spawned.
+    // pool->size is bumped after each successful spawn so that a failure
+    // leaves a smaller but consistent pool
+    for (size_t i = 1; i < size; ++i) {
+        ThreadPool_worker_arg *arg = malloc(sizeof(ThreadPool_worker_arg));
+        if (!arg) {
+            break;
+        }
+        *arg = (ThreadPool_worker_arg){.pool = pool, .slot = i};
+
+        pthread_mutex_lock(&pool->lock);
+        if (pthread_create(&threads[i], NULL, ThreadPool_worker, arg) != 0) {
+            pthread_mutex_unlock(&pool->lock);
+            free(arg);
+            break;
+        }
+        pool->size = i + 1;
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    return pool;
+}
+
+static ThreadPool *shared_pool = NULL;
+
+static void ThreadPool_create_shared(void) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    shared_pool = ThreadPool_create(cpus > 0 ? (size_t)cpus : 1);
+}
+
+// process wide pool, created on first use and kept alive until exit
+ThreadPool *ThreadPool_shared(void) {
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once(&once, ThreadPool_create_shared);
+    return shared_pool;
+}
+
+size_t ThreadPool_size(const ThreadPool *pool) { return pool ? pool->size : 1; }
+
+// split [0, n) into one contiguous chunk per slot and run fn on all of them,
+// returning once every chunk is done. if the pool is already busy with
+// another caller (or there is nothing to split) fn runs inline on slot 0
+void ThreadPool_parallel_for(ThreadPool *pool, size_t n, ThreadPool_fn fn,
+                             void *ctx) {
+    if (n == 0) {
+        return;
+    }
+    if (!pool || pool->size == 1 || n == 1 ||
+        pthread_mutex_trylock(&pool->dispatch) != 0) {
+        fn(ctx, 0, n, 0);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->fn = fn;
+    pool->ctx = ctx;
+    pool->n = n;
+    pool->pending = pool->size - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->work_ready);
+    pthread_mutex_unlock(&pool->lock);
+
+    size_t end = ThreadPool_chunk_begin(n, pool->size, 1);
+    if (end > 0) {
+        fn(ctx, 0, end, 0);
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending > 0) {
+        pthread_cond_wait(&pool->work_done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    pthread_mutex_unlock(&pool->dispatch);
+}
+
+#endif // THREAD_POOL_C
@@ -1,6 +1,7 @@
 #ifndef UINT32_ARRAY_C
 #define UINT32_ARRAY_C
 
+#include "profile.c"
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -26,6 +27,7 @@ UInt32Array UInt32Array_create(const size_t length, const size_t capacity) {
     if (!raw_array) {
         return UInt32Array_null();
     }
+    Profile_alloc(capacity * sizeof(uint32_t));
 
     return (UInt32Array){
         .items = raw_array,
@@ -36,6 +38,7 @@ UInt32Array UInt32Array_create(const size_t length, const size_t capacity) {
 
 void UInt32Array_destroy(UInt32Array *array) {
     if (array && array->items) {
+        Profile_free(array->capacity * sizeof(uint32_t));
         free(array->items);
         array->items = NULL;
         array->length = 0;
@@ -67,6 +70,7 @@ UInt32Array UInt32Array_copy(const UInt32Array array) {
     if (!raw_array_copy) {
         return UInt32Array_null();
     }
+    Profile_alloc(array.capacity * sizeof(uint32_t));
 
     if (array.length > 0) {
         memcpy(raw_array_copy, array.items, array.length * sizeof(uint32_t));
@@ -0,0 +1,271 @@
+#ifndef UNDO_JOURNAL_C
+#define UNDO_JOURNAL_C
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define UNDO_JOURNAL_NO_SPAWN SIZE_MAX
+#define UNDO_JOURNAL_INITIAL_CAPACITY 16
+
+// one undoable move. cells[offset, offset + length) of the arena holds either
+// (index, old value) pairs for every tile the move changed, or a keyframe
+// with the whole board as it was before the move
+typedef struct {
+    size_t offset;
+    size_t length;
+    size_t spawn;
+    uint32_t score_delta;
+    bool keyframe;
+} UndoEntry;
+
+typedef struct UndoJournal UndoJournal;
+
+// storage for a journal whose arrays are not on the heap, e.g. in a mapped
+// file. it has to make room for capacity entries and cells_capacity cells,
+// keeping those already there, and point the journal at them
+typedef bool (*UndoJournal_grow_fn)(void *ctx, UndoJournal *journal,
+                                    size_t capacity, size_t cells_capacity);
+
+// history of moves, newest last. live entries are entries[first, count), and
+// their cells sit contiguously in the arena starting at entries[first].offset
+struct UndoJournal {
+    UndoEntry *entries;
+    size_t first;
+    size_t count;
+    size_t capacity;
+    uint32_t *cells;
+    size_t cells_length;
+    size_t cells_capacity;
+    size_t board_size; // of the entry being journaled
+    UndoJournal_grow_fn grow; // NULL if the arrays are on the heap
+    void *grow_ctx;
+};
+
+UndoJournal *UndoJournal_create(void) {
+    UndoJournal *journal = malloc(sizeof(UndoJournal));
+    if (!journal) {
+        return NULL;
+    }
+
+    *journal = (UndoJournal){
+        .entries = NULL,
+        .first = 0,
+        .count = 0,
+        .capacity = 0,
+        .cells = NULL,
+        .cells_length = 0,
+        .cells_capacity = 0,
+        .board_size = 0,
+        .grow = NULL,
+        .grow_ctx = NULL,
+    };
+    return journal;
+}
+
+// frees the journal, and its arrays unless they belong to a grow callback
+void UndoJournal_destroy(UndoJournal *journal) {
+    if (journal) {
+        if (!journal->grow) {
+            free(journal->entries);
+            free(journal->cells);
+        }
+        free(journal);
+    }
+}
+
+// take over the history in saved, whose arrays are kept by grow. the arrays
+// the journal had are freed, from now on grow is called when they are full
+void UndoJournal_attach(UndoJournal *journal, const UndoJournal *saved,
+                        UndoJournal_grow_fn grow, void *ctx) {
+    if (!journal->grow) {
+        free(journal->entries);
+        free(journal->cells);
+    }
+    *journal = *saved;
+    journal->board_size = 0;
+    journal->grow = grow;
+    journal->grow_ctx = ctx;
+}
+
+size_t UndoJournal_length(const UndoJournal *journal) {
+    return journal ? journal->count - journal->first : 0;
+}
+
+static bool UndoJournal_reserve_cells(UndoJournal *journal, size_t extra) {
+    size_t needed = journal->cells_length + extra;
+    if (needed <= journal->cells_capacity) {
+        return true;
+    }
+
+    size_t capacity = journal->cells_capacity;
+    if (capacity < UNDO_JOURNAL_INITIAL_CAPACITY) {
+        capacity = UNDO_JOURNAL_INITIAL_CAPACITY;
+    }
+    while (capacity < needed) {
+        capacity *= 2;
+    }
+
+    if (journal->grow) {
+        return journal->grow(journal->grow_ctx, journal, journal->capacity,
+                             capacity);
+    }
+    uint32_t *cells = realloc(journal->cells, capacity * sizeof(uint32_t));
+    if (!cells) {
+        return false;
+    }
+    journal->cells = cells;
+    journal->cells_capacity = capacity;
+    return true;
+}
+
+static bool UndoJournal_reserve_entry(UndoJournal *journal) {
+    if (journal->count < journal->capacity) {
+        return true;
+    }
+
+    size_t capacity = journal->capacity < UNDO_JOURNAL_INITIAL_CAPACITY
+                          ? UNDO_JOURNAL_INITIAL_CAPACITY
+                          : journal->capacity * 2;
+    if (journal->grow) {
+        return journal->grow(journal->grow_ctx, journal, capacity,
+                             journal->cells_capacity);
+    }
+    UndoEntry *entries =
+        realloc(journal->entries, capacity * sizeof(UndoEntry));
+    if (!entries) {
+        return false;
+    }
+    journal->entries = entries;
+    journal->capacity = capacity;
+    return true;
+}
+
+// start journaling a move on a board of size cells. the cells the move
+// changed are then passed to UndoJournal_add and the entry is closed with
+// UndoJournal_commit
+bool UndoJournal_begin(UndoJournal *journal, size_t size,
+                       uint32_t score_delta) {
+    if (!journal || !UndoJournal_reserve_entry(journal) ||
+        !UndoJournal_reserve_cells(journal, size)) {
+        return false;
+    }
+
+    journal->entries[journal->count] = (UndoEntry){
+        .offset = journal->cells_length,
+        .length = 0,
+        .spawn = UNDO_JOURNAL_NO_SPAWN,
+        .score_delta = score_delta,
+        .keyframe = false,
+    };
+    journal->board_size = size;
+    return true;
+}
+
+// note that cell index held old before the move. once the pairs would take
+// as much room as the board itself the entry turns into a keyframe instead
+void UndoJournal_add(UndoJournal *journal, size_t index, uint32_t old) {
+    UndoEntry *entry = &journal->entries[journal->count];
+    if (entry->keyframe) {
+        return;
+    }
+    if (entry->length + 2 >= journal->board_size) {
+        entry->keyframe = true;
+        return;
+    }
+
+    uint32_t *out = journal->cells + entry->offset;
+    out[entry->length++] = (uint32_t)index;
+    out[entry->length++] = old;
+}
+
+// close the entry opened by UndoJournal_begin. before is the whole board as
+// it was before the move, only read if the entry became a keyframe
+void UndoJournal_commit(UndoJournal *journal, const uint32_t *before) {
+    UndoEntry *entry = &journal->entries[journal->count];
+    if (entry->keyframe) {
+        memcpy(journal->cells + entry->offset, before,
+               journal->board_size * sizeof(uint32_t));
+        entry->length = journal->board_size;
+    }
+    journal->cells_length += entry->length;
+    journal->count++;
+}
+
+// remember where the tile spawned after the newest move landed, so undoing it
+// also clears that tile
+void UndoJournal_mark_spawn(UndoJournal *journal, size_t index) {
+    if (UndoJournal_length(journal) == 0) {
+        return;
+    }
+
+    UndoEntry *top = &journal->entries[journal->count - 1];
+    if (top->spawn == UNDO_JOURNAL_NO_SPAWN) {
+        top->spawn = index;
+    }
+}
+
+// the newest move, or NULL if there is nothing to undo. its cells start at
+// journal->cells + offset
+const UndoEntry *UndoJournal_top(const UndoJournal *journal) {
+    if (UndoJournal_length(journal) == 0) {
+        return NULL;
+    }
+    return &journal->entries[journal->count - 1];
+}
+
+// forget the newest move once it has been reverted
+void UndoJournal_drop(UndoJournal *journal) {
+    if (UndoJournal_length(journal) == 0) {
+        return;
+    }
+
+    journal->cells_length = journal->entries[--journal->count].offset;
+    if (journal->count == journal->first) {
+        journal->first = 0;
+        journal->count = 0;
+        journal->cells_length = 0;
+    }
+}
+
+// slide the live entries back to the start of the arena once more than half
+// of it is dead, so trimming stays amortised O(1) per move
+void UndoJournal_compact(UndoJournal *journal) {
+    if (!journal || journal->first <= journal->count / 2) {
+        return;
+    }
+
+    size_t keep = UndoJournal_length(journal);
+    size_t base = keep > 0 ? journal->entries[journal->first].offset
+                           : journal->cells_length;
+    size_t live_cells = journal->cells_length - base;
+    memmove(journal->cells, journal->cells + base,
+            live_cells * sizeof(uint32_t));
+    memmove(journal->entries, journal->entries + journal->first,
+            keep * sizeof(UndoEntry));
+    for (size_t i = 0; i < keep; ++i) {
+        journal->entries[i].offset -= base;
+    }
+
+    journal->first = 0;
+    journal->count = keep;
+    journal->cells_length = live_cells;
+}
+
+// forget all but the newest keep entries. a journal kept by a grow callback
+// is left for its owner to compact, as that moves the entries it keeps
+void UndoJournal_trim(UndoJournal *journal, size_t keep) {
+    size_t length = UndoJournal_length(journal);
+    if (length <= keep) {
+        return;
+    }
+
+    journal->first += length - keep;
+    if (!journal->grow) {
+        UndoJournal_compact(journal);
+    }
+}
+
+#endif // UNDO_JOURNAL_C